@@ -76,6 +76,21 @@ struct Slots {
 // relay back to the client application the current execution state.
 typedef std::function<void(Action, ProgressCode)> ReportProgressFunction;
 
+// Bulk transfers between local disk and the virtual drive, e.g. ImportDirectory, report the number
+// of bytes processed so far and the total number of bytes to be processed.  Calls may come from
+// any worker thread, but are never concurrent and never report fewer bytes than an earlier call.
+typedef std::function<void(uint64_t, uint64_t)> TransferProgressFunction;
+
+// Describes one entry of a drive directory, see LifeStuff::ListDirectory.
+struct DirectoryEntry {
+  DirectoryEntry() : name(), is_directory(false), size(0), last_write_time(0) {}
+  std::string name;
+  bool is_directory;
+  uint64_t size;
+  // Seconds since the epoch.
+  int64_t last_write_time;
+};
+
 // Some internally used constants.
 const std::string kAppHomeDirectory(".lifestuff");
 const std::string kOwner("Owner");
@@ -16,7 +16,10 @@ License.
 #ifndef MAIDSAFE_LIFESTUFF_LIFESTUFF_API_H_
 #define MAIDSAFE_LIFESTUFF_LIFESTUFF_API_H_
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "maidsafe/lifestuff/lifestuff.h"
 
@@ -76,6 +79,67 @@ class LifeStuff {
   void MountDrive();
   // Unmounts a mounted virtual drive when user has not logged in.
   void UnMountDrive();
+  // Copies the contents of local directory 'local_path' into 'drive_path', relative to
+  // owner_path(), without routing file contents through the mounted drive. Files are encrypted
+  // and stored in parallel; 'progress' is called as each file completes. Throws
+  // CommonErrors::uninitialised if the drive is not mounted.
+  void ImportDirectory(const std::string& local_path,
+                       const std::string& drive_path,
+                       const TransferProgressFunction& progress);
+  // Copies local file 'local_path' to 'drive_path', relative to owner_path(). Large files are
+  // encrypted on several threads and uploaded while encryption proceeds; the file appears on the
+  // drive once all of its content is stored.
+  void ImportFile(const std::string& local_path,
+                  const std::string& drive_path,
+                  const TransferProgressFunction& progress);
+  // Restores 'drive_path', relative to owner_path(), into local directory 'local_path'. The
+  // subtree is listed up front and chunks are fetched in parallel across files. An interrupted
+  // export resumes when called again with the same arguments. Throws
+  // CommonErrors::uninitialised if the drive is not mounted.
+  void ExportDirectory(const std::string& drive_path,
+                       const std::string& local_path,
+                       const TransferProgressFunction& progress);
+  // Copies a file within the drive, both paths relative to owner_path(). The copy references the
+  // source's chunks, so no content is re-encrypted or re-uploaded regardless of file size.
+  void CopyFile(const std::string& source_path, const std::string& destination_path);
+  // Appends 'content' to the existing file at 'drive_path', relative to owner_path(). Only the
+  // few chunks at the start and end of the file are re-encrypted, so appending to a large file,
+  // e.g. a log, costs the same as appending to a small one.
+  void AppendToFile(const std::string& drive_path, const std::string& content);
+  // Records a read-only, point-in-time snapshot of the owner tree. Unchanged file contents are
+  // shared with the live drive, so the cost depends on the number of entries, not their size.
+  void TakeSnapshot(const std::string& name);
+  // Recreates a snapshot's tree at 'drive_path', relative to owner_path().
+  void RestoreSnapshot(const std::string& name, const std::string& drive_path);
+  void DeleteSnapshot(const std::string& name);
+  std::vector<std::string> ListSnapshots() const;
+  // Lists 'drive_path', relative to owner_path(). Listings are served from a local index of the
+  // tree which is kept between sessions and refreshed in the background after mounting.
+  std::vector<DirectoryEntry> ListDirectory(const std::string& drive_path);
+  // Returns one page of the listing of 'drive_path' in name order: up to 'max_entries' entries
+  // named after 'start_after'. Pass the last name returned to fetch the next page; an empty result
+  // marks the end of the directory.
+  std::vector<DirectoryEntry> ListDirectory(const std::string& drive_path,
+                                            const std::string& start_after,
+                                            size_t max_entries);
+  // Bytes stored and allowed for this account. While logged in, used space is updated as content
+  // is stored, and imports which would exceed the allowance fail before anything is uploaded.
+  int64_t used_space();
+  int64_t max_space();
+  // Limits the rate at which content is uploaded and downloaded, in bytes per second, for every
+  // session in the process, as they share the same link. Zero removes a limit. Can be changed at
+  // any time. Credential and session operations are never held back, and bulk transfers slow
+  // further by themselves while the network is unhealthy.
+  void SetBandwidthLimits(uint64_t upload_bytes_per_second, uint64_t download_bytes_per_second);
+  // Keeps the file or directory at 'drive_path', relative to owner_path(), in local storage so it
+  // opens instantly and can be read without the network. Returns once it is held locally; it is
+  // then kept up to date in the background. Pins are kept between sessions on this device.
+  void PinPath(const std::string& drive_path);
+  void UnpinPath(const std::string& drive_path);
+  std::vector<std::string> PinnedPaths();
+  // Bytes held locally for pinned content, counted before compression, and not included in
+  // used_space().
+  uint64_t pinned_space();
 
   // The following methods can be used to change a user's credentials.
   void ChangeKeyword();
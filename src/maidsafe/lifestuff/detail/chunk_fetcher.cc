@@ -0,0 +1,175 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/chunk_fetcher.h"
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/data_types/immutable_data.h"
+
+#include "maidsafe/nfs/client_utils.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+bool HoldsChunk(data_store::PermanentStore& data_store, const std::string& chunk_name) {
+  try {
+    data_store.Get(ImmutableData::name_type(Identity(chunk_name)));
+    return true;
+  }
+  catch(const std::exception&) {
+    return false;
+  }
+}
+
+bool HoldsChunks(data_store::PermanentStore& data_store, const encrypt::DataMap& data_map) {
+  for (auto& chunk : data_map.chunks) {
+    if (!HoldsChunk(data_store, chunk.hash))
+      return false;
+  }
+  return true;
+}
+
+ChunkFetcher::ChunkFetcher(ClientNfs& client_nfs,
+                           PermanentStore& data_store,
+                           NfsScheduler& scheduler,
+                           TokenBucket& bandwidth,
+                           NfsPriority priority,
+                           uint32_t max_in_flight)
+    : client_nfs_(client_nfs),
+      data_store_(data_store),
+      scheduler_(scheduler),
+      bandwidth_(bandwidth),
+      kPriority_(priority),
+      kMaxInFlight_(max_in_flight == 0 ? 1 : max_in_flight),
+      in_flight_(0),
+      bytes_fetched_(0),
+      mutex_(),
+      condition_variable_() {}
+
+void ChunkFetcher::Fetch(const encrypt::DataMap& data_map) {
+  typedef std::future<std::unique_ptr<ImmutableData>> ChunkFuture;
+  typedef std::pair<ImmutableData::name_type, ChunkFuture> Request;
+  std::deque<Request> pending;
+  std::deque<NfsScheduler::Ticket> tickets;
+  std::set<std::string> requested;
+  bool failed(false);
+  auto collect([&] {
+    Request& request(pending.front());
+    try {
+      std::unique_ptr<ImmutableData> chunk(request.second.get());
+      NonEmptyString content(chunk->data());
+      data_store_.Put(request.first, content);
+      bytes_fetched_ += content.string().size();
+    }
+    catch(const std::exception& e) {
+      LOG(kError) << "Failed to fetch chunk " << HexSubstr(request.first.data.string()) << ": "
+                  << e.what();
+      failed = true;
+    }
+    scheduler_.Release(tickets.front());
+    pending.pop_front();
+    tickets.pop_front();
+    ReleaseSlot();
+  });
+
+  // Gets for one data map are issued back to back so that they overlap.  A caller never blocks
+  // waiting for a slot, its own or the scheduler's, while holding slots of its own; it collects its
+  // oldest reply instead.
+  for (auto& chunk : data_map.chunks) {
+    if (failed)
+      break;
+    // Repeated chunks, such as those filling the holes of a sparse file, are requested once.
+    if (!requested.insert(chunk.hash).second || HoldsChunk(data_store_, chunk.hash))
+      continue;
+    while (!TryAcquireSlot()) {
+      if (pending.empty()) {
+        AcquireSlot();
+        break;
+      }
+      collect();
+    }
+    bandwidth_.Consume(chunk.size, kPriority_);
+    NfsScheduler::Ticket ticket;
+    while (!scheduler_.TryAcquire(kPriority_, chunk.size, &ticket)) {
+      if (pending.empty()) {
+        ticket = scheduler_.Acquire(kPriority_, chunk.size);
+        break;
+      }
+      collect();
+    }
+    ImmutableData::name_type name((Identity(chunk.hash)));
+    try {
+      pending.push_back(Request(name, maidsafe::nfs::Get<ImmutableData>(client_nfs_, name)));
+      tickets.push_back(ticket);
+    }
+    catch(const std::exception& e) {
+      LOG(kError) << "Failed to request chunk " << HexSubstr(chunk.hash) << ": " << e.what();
+      scheduler_.Release(ticket);
+      ReleaseSlot();
+      failed = true;
+    }
+  }
+  while (!pending.empty())
+    collect();
+  if (failed)
+    ThrowError(NfsErrors::failed_to_get_data);
+}
+
+void ChunkFetcher::ReadThrough(const encrypt::DataMap& data_map,
+                               const std::function<void()>& read) {
+  try {
+    read();
+    return;
+  }
+  catch(const std::exception& e) {
+    LOG(kVerbose) << "Fetching chunks missing from the local store: " << e.what();
+  }
+  Fetch(data_map);
+  read();
+}
+
+bool ChunkFetcher::TryAcquireSlot() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (in_flight_ >= kMaxInFlight_)
+    return false;
+  ++in_flight_;
+  return true;
+}
+
+void ChunkFetcher::AcquireSlot() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_variable_.wait(lock, [this] { return in_flight_ < kMaxInFlight_; });
+  ++in_flight_;
+}
+
+void ChunkFetcher::ReleaseSlot() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+  }
+  condition_variable_.notify_one();
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
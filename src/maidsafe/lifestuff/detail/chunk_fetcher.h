@@ -0,0 +1,94 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_FETCHER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_FETCHER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "maidsafe/data_store/permanent_store.h"
+
+#include "maidsafe/encrypt/data_map.h"
+
+#include "maidsafe/nfs/nfs.h"
+
+#include "maidsafe/lifestuff/detail/nfs_scheduler.h"
+#include "maidsafe/lifestuff/detail/token_bucket.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Returns true if 'chunk_name' is held in 'data_store'.  PermanentStore has no presence query, so
+// this reads the chunk; callers checking many chunks should expect to pay for reading them.
+bool HoldsChunk(data_store::PermanentStore& data_store, const std::string& chunk_name);
+// Returns true if every chunk of 'data_map' is held in 'data_store', stopping at the first missing.
+bool HoldsChunks(data_store::PermanentStore& data_store, const encrypt::DataMap& data_map);
+
+// Retrieves chunks from the network into the local PermanentStore.  Any number of threads may call
+// Fetch concurrently; between them at most 'max_in_flight' gets are outstanding at any time.  Each
+// get is issued once 'bandwidth' allows its size and 'scheduler' grants it a slot in class
+// 'priority'.
+class ChunkFetcher {
+ public:
+  typedef nfs::ClientMaidNfs ClientNfs;
+  typedef data_store::PermanentStore PermanentStore;
+
+  ChunkFetcher(ClientNfs& client_nfs,
+               PermanentStore& data_store,
+               NfsScheduler& scheduler,
+               TokenBucket& bandwidth,
+               NfsPriority priority,
+               uint32_t max_in_flight);
+  ~ChunkFetcher() {}
+
+  // Blocks until every chunk referenced by 'data_map' is held locally.  Throws if any chunk
+  // could not be retrieved.  Checking which chunks are already held means reading them, so callers
+  // about to read the chunks anyway should use ReadThrough instead.
+  void Fetch(const encrypt::DataMap& data_map);
+  // Runs 'read', which reads the chunks of 'data_map' from the local store, and only if it throws,
+  // fetches the chunks and runs it again.  Chunks already held are then read just once.
+  void ReadThrough(const encrypt::DataMap& data_map, const std::function<void()>& read);
+
+  uint64_t bytes_fetched() const { return bytes_fetched_; }
+
+ private:
+  ChunkFetcher(const ChunkFetcher&);
+  ChunkFetcher& operator=(const ChunkFetcher&);
+
+  bool TryAcquireSlot();
+  void AcquireSlot();
+  void ReleaseSlot();
+
+  ClientNfs& client_nfs_;
+  PermanentStore& data_store_;
+  NfsScheduler& scheduler_;
+  TokenBucket& bandwidth_;
+  const NfsPriority kPriority_;
+  const uint32_t kMaxInFlight_;
+  uint32_t in_flight_;
+  std::atomic<uint64_t> bytes_fetched_;
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_FETCHER_H_
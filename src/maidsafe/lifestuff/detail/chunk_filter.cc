@@ -0,0 +1,215 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/chunk_filter.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+const uint32_t kFilterVersion(2);
+// Forgotten names are held in full, so their number is bounded, at 4 MB of 64-byte names.
+const size_t kMaxForgottenCount(65536);
+
+// Optimal Bloom filter dimensions: m = -n ln(p) / (ln 2)^2 bits and k = (m / n) ln 2 hashes.
+uint64_t BitCount(uint64_t capacity, double false_positive_rate) {
+  double bits(-static_cast<double>(capacity) * std::log(false_positive_rate) /
+              (std::log(2.0) * std::log(2.0)));
+  // Rounded up to whole words.
+  return ((static_cast<uint64_t>(bits) + 63) / 64) * 64;
+}
+
+uint32_t HashCount(uint64_t capacity, uint64_t bit_count) {
+  double hashes(static_cast<double>(bit_count) / static_cast<double>(capacity) * std::log(2.0));
+  return hashes < 1.0 ? 1 : static_cast<uint32_t>(hashes + 0.5);
+}
+
+uint64_t ReadWord(const std::string& bytes, size_t offset) {
+  uint64_t word(0);
+  std::memcpy(&word, bytes.data() + offset, sizeof(word));
+  return word;
+}
+
+}  // unnamed namespace
+
+ChunkFilter::ChunkFilter(uint64_t capacity, double target_false_positive_rate)
+    : kBitCount_(BitCount(capacity == 0 ? 1 : capacity, target_false_positive_rate)),
+      kHashCount_(HashCount(capacity == 0 ? 1 : capacity, kBitCount_)),
+      kMaxFalsePositiveRate_(target_false_positive_rate * 10),
+      bits_(kBitCount_ / 64, 0),
+      bits_set_(0),
+      entry_count_(0),
+      forgotten_(),
+      mutex_() {}
+
+bool ChunkFilter::Load(const fs::path& filter_path) {
+  fs::ifstream input(filter_path, std::ios_base::in | std::ios_base::binary);
+  uint32_t version(0), hash_count(0);
+  uint64_t bit_count(0), entry_count(0);
+  input.read(reinterpret_cast<char*>(&version), sizeof(version));
+  input.read(reinterpret_cast<char*>(&hash_count), sizeof(hash_count));
+  input.read(reinterpret_cast<char*>(&bit_count), sizeof(bit_count));
+  input.read(reinterpret_cast<char*>(&entry_count), sizeof(entry_count));
+  if (!input.good() || version != kFilterVersion || hash_count != kHashCount_ ||
+      bit_count != kBitCount_) {
+    LOG(kInfo) << "No usable chunk filter at " << filter_path;
+    return false;
+  }
+  std::vector<uint64_t> bits(kBitCount_ / 64, 0);
+  input.read(reinterpret_cast<char*>(&bits[0]),
+             static_cast<std::streamsize>(bits.size() * sizeof(uint64_t)));
+  uint64_t forgotten_count(0);
+  input.read(reinterpret_cast<char*>(&forgotten_count), sizeof(forgotten_count));
+  std::set<std::string> forgotten;
+  for (uint64_t i(0); input.good() && i != forgotten_count; ++i) {
+    uint32_t size(0);
+    input.read(reinterpret_cast<char*>(&size), sizeof(size));
+    std::string chunk_name(size, 0);
+    if (size != 0)
+      input.read(&chunk_name[0], size);
+    forgotten.insert(chunk_name);
+  }
+  if (!input.good() || forgotten_count > kMaxForgottenCount) {
+    LOG(kWarning) << "Truncated chunk filter at " << filter_path;
+    return false;
+  }
+  uint64_t bits_set(0);
+  for (auto word : bits) {
+    for (; word != 0; word &= word - 1)
+      ++bits_set;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  bits_.swap(bits);
+  bits_set_ = bits_set;
+  entry_count_ = entry_count;
+  forgotten_.swap(forgotten);
+  return true;
+}
+
+void ChunkFilter::Save(const fs::path& filter_path) const {
+  // Write to a temporary file first, so a crash never leaves a truncated filter in place.
+  fs::path temp_path(filter_path.string() + ".tmp");
+  {
+    fs::ofstream output(temp_path, std::ios_base::out | std::ios_base::binary |
+                                   std::ios_base::trunc);
+    std::lock_guard<std::mutex> lock(mutex_);
+    output.write(reinterpret_cast<const char*>(&kFilterVersion), sizeof(kFilterVersion));
+    output.write(reinterpret_cast<const char*>(&kHashCount_), sizeof(kHashCount_));
+    output.write(reinterpret_cast<const char*>(&kBitCount_), sizeof(kBitCount_));
+    output.write(reinterpret_cast<const char*>(&entry_count_), sizeof(entry_count_));
+    output.write(reinterpret_cast<const char*>(&bits_[0]),
+                 static_cast<std::streamsize>(bits_.size() * sizeof(uint64_t)));
+    uint64_t forgotten_count(forgotten_.size());
+    output.write(reinterpret_cast<const char*>(&forgotten_count), sizeof(forgotten_count));
+    for (auto& chunk_name : forgotten_) {
+      uint32_t size(static_cast<uint32_t>(chunk_name.size()));
+      output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      output.write(chunk_name.data(), size);
+    }
+    if (!output.good()) {
+      LOG(kError) << "Failed to write chunk filter to " << temp_path;
+      return;
+    }
+  }
+  boost::system::error_code error_code;
+  fs::rename(temp_path, filter_path, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to replace chunk filter at " << filter_path << ": "
+                << error_code.message();
+  }
+}
+
+void ChunkFilter::Add(const std::string& chunk_name) {
+  std::vector<uint64_t> indices(BitIndices(chunk_name));
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto index : indices) {
+    uint64_t mask(1ULL << (index % 64));
+    if ((bits_[index / 64] & mask) == 0) {
+      bits_[index / 64] |= mask;
+      ++bits_set_;
+    }
+  }
+  ++entry_count_;
+  forgotten_.erase(chunk_name);
+}
+
+bool ChunkFilter::MayContain(const std::string& chunk_name) const {
+  std::vector<uint64_t> indices(BitIndices(chunk_name));
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (FalsePositiveRate() > kMaxFalsePositiveRate_ || forgotten_.count(chunk_name) != 0)
+    return false;
+  for (auto index : indices) {
+    if ((bits_[index / 64] & (1ULL << (index % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+void ChunkFilter::Forget(const std::string& chunk_name) {
+  if (!MayContain(chunk_name))
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (forgotten_.size() < kMaxForgottenCount) {
+    forgotten_.insert(chunk_name);
+    return;
+  }
+  LOG(kInfo) << "Clearing chunk filter after " << forgotten_.size() << " chunks were forgotten.";
+  bits_.assign(bits_.size(), 0);
+  bits_set_ = 0;
+  entry_count_ = 0;
+  forgotten_.clear();
+}
+
+uint64_t ChunkFilter::entry_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entry_count_;
+}
+
+double ChunkFilter::false_positive_rate() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return FalsePositiveRate();
+}
+
+std::vector<uint64_t> ChunkFilter::BitIndices(const std::string& chunk_name) const {
+  // Chunk names are hashes already, so their first 16 bytes serve as two independent 64-bit hashes
+  // from which the k indices are derived by double hashing.  Any shorter name is hashed first.
+  std::string digest(chunk_name.size() >= 2 * sizeof(uint64_t) ?
+                     chunk_name : crypto::Hash<crypto::SHA512>(chunk_name).string());
+  uint64_t first(ReadWord(digest, 0)), second(ReadWord(digest, sizeof(uint64_t)) | 1);
+  std::vector<uint64_t> indices;
+  for (uint32_t i(0); i != kHashCount_; ++i)
+    indices.push_back((first + i * second) % kBitCount_);
+  return indices;
+}
+
+double ChunkFilter::FalsePositiveRate() const {
+  return std::pow(static_cast<double>(bits_set_) / static_cast<double>(kBitCount_),
+                  static_cast<double>(kHashCount_));
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,78 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_FILTER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_FILTER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// A Bloom filter of the names of chunks this account has had confirmed stored, so that puts of
+// chunks already on the network can be skipped.  It is sized for 'capacity' names at
+// 'target_false_positive_rate'.  A false positive means a put is wrongly skipped, so once the
+// filter has filled to where its estimated rate exceeds ten times the target, MayContain stops
+// reporting hits rather than degrade further.  Bloom filters can't remove names, so chunks which
+// may have been deleted from the network are instead recorded as forgotten until added again;
+// once too many are held, the filter is cleared.
+//
+// The file it is saved to holds no more than the names of the chunks in the local store, which
+// are already visible there, so it is not encrypted.
+class ChunkFilter {
+ public:
+  ChunkFilter(uint64_t capacity, double target_false_positive_rate);
+  ~ChunkFilter() {}
+
+  // Replaces the filter's contents with those saved at 'filter_path'.  Returns false, leaving the
+  // filter empty, if there is no saved filter or it was saved with different dimensions.
+  bool Load(const boost::filesystem::path& filter_path);
+  void Save(const boost::filesystem::path& filter_path) const;
+
+  void Add(const std::string& chunk_name);
+  bool MayContain(const std::string& chunk_name) const;
+  // Stops MayContain reporting 'chunk_name' until it is added again.
+  void Forget(const std::string& chunk_name);
+
+  uint64_t entry_count() const;
+  // Estimated from the proportion of bits set.
+  double false_positive_rate() const;
+
+ private:
+  ChunkFilter(const ChunkFilter&);
+  ChunkFilter& operator=(const ChunkFilter&);
+
+  std::vector<uint64_t> BitIndices(const std::string& chunk_name) const;
+  double FalsePositiveRate() const;
+
+  const uint64_t kBitCount_;
+  const uint32_t kHashCount_;
+  const double kMaxFalsePositiveRate_;
+  std::vector<uint64_t> bits_;
+  uint64_t bits_set_, entry_count_;
+  std::set<std::string> forgotten_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_FILTER_H_
@@ -0,0 +1,112 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/chunk_scrubber.h"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/data_types/immutable_data.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+ChunkScrubber::ChunkScrubber(PermanentStore& data_store, uint64_t bytes_per_second)
+    : data_store_(data_store),
+      bandwidth_(),
+      checked_(),
+      corrupt_(),
+      progress_(),
+      mutex_() {
+  // A second's worth of reading may be done at once.
+  bandwidth_.SetLimit(bytes_per_second, bytes_per_second);
+}
+
+void ChunkScrubber::StartPass() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  checked_.clear();
+  corrupt_.clear();
+  progress_.chunks_checked = 0;
+  progress_.bytes_checked = 0;
+}
+
+void ChunkScrubber::FinishPass() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  checked_.clear();
+  corrupt_.clear();
+  ++progress_.passes_completed;
+  LOG(kInfo) << "Scrub pass checked " << progress_.chunks_checked << " chunks, "
+             << progress_.bytes_checked << " bytes; " << progress_.corrupt_chunks
+             << " corrupt chunks found so far.";
+}
+
+size_t ChunkScrubber::Check(const std::vector<encrypt::ChunkDetails>& chunks) {
+  size_t corrupt(0);
+  for (auto& chunk : chunks) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!checked_.insert(chunk.hash).second) {
+        corrupt += corrupt_.count(chunk.hash);
+        continue;
+      }
+    }
+    bandwidth_.Consume(chunk.size, NfsPriority::kBackground);
+    ImmutableData::name_type name((Identity(chunk.hash)));
+    std::string content;
+    try {
+      content = data_store_.Get(name).string();
+    }
+    catch(const std::exception&) {
+      continue;  // Not held locally.
+    }
+    bool intact(crypto::Hash<crypto::SHA512>(content).string() == chunk.hash);
+    if (!intact) {
+      LOG(kWarning) << "Chunk " << HexSubstr(chunk.hash) << " is corrupt; removing it.";
+      try {
+        data_store_.Delete(name);
+      }
+      catch(const std::exception& e) {
+        LOG(kError) << "Failed to remove corrupt chunk " << HexSubstr(chunk.hash) << ": "
+                    << e.what();
+      }
+      ++corrupt;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++progress_.chunks_checked;
+    progress_.bytes_checked += content.size();
+    if (!intact) {
+      corrupt_.insert(chunk.hash);
+      ++progress_.corrupt_chunks;
+    }
+  }
+  return corrupt;
+}
+
+void ChunkScrubber::RecordReplacements(size_t count, bool succeeded) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (succeeded)
+    progress_.chunks_replaced += count;
+  else
+    progress_.replacement_failures += count;
+}
+
+ChunkScrubber::Progress ChunkScrubber::progress() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return progress_;
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,86 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_SCRUBBER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_SCRUBBER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "maidsafe/data_store/permanent_store.h"
+
+#include "maidsafe/encrypt/data_map.h"
+
+#include "maidsafe/lifestuff/detail/token_bucket.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Verifies chunks held in the local PermanentStore against their names, which are the hashes of
+// their content, so that chunks left corrupt or truncated by a crash are found before a read
+// fails on them.  Corrupt chunks are deleted from the store, to be fetched again when next needed.
+// Reads are limited to 'bytes_per_second' so that scrubbing doesn't compete with foreground work.
+// The store can't be listed, so chunks are checked as the data maps referencing them are passed
+// in, each at most once per pass.
+class ChunkScrubber {
+ public:
+  typedef data_store::PermanentStore PermanentStore;
+
+  struct Progress {
+    Progress()
+        : passes_completed(0),
+          chunks_checked(0),
+          bytes_checked(0),
+          corrupt_chunks(0),
+          chunks_replaced(0),
+          replacement_failures(0) {}
+    uint64_t passes_completed;
+    // Counted since the current or last pass started.
+    uint64_t chunks_checked, bytes_checked;
+    // Counted since the scrubber was created.
+    uint64_t corrupt_chunks, chunks_replaced, replacement_failures;
+  };
+
+  ChunkScrubber(PermanentStore& data_store, uint64_t bytes_per_second);
+  ~ChunkScrubber() {}
+
+  void StartPass();
+  void FinishPass();
+  // Checks each of 'chunks' held locally and not yet checked this pass.  Returns the number of
+  // them found corrupt this pass, by this or an earlier call, all of which have been deleted from
+  // the store.
+  size_t Check(const std::vector<encrypt::ChunkDetails>& chunks);
+  // Records the outcome of fetching replacements for 'count' corrupt chunks.
+  void RecordReplacements(size_t count, bool succeeded);
+  Progress progress() const;
+
+ private:
+  ChunkScrubber(const ChunkScrubber&);
+  ChunkScrubber& operator=(const ChunkScrubber&);
+
+  PermanentStore& data_store_;
+  TokenBucket bandwidth_;
+  std::set<std::string> checked_, corrupt_;
+  Progress progress_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_SCRUBBER_H_
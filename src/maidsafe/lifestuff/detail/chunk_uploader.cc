@@ -0,0 +1,290 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/chunk_uploader.h"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/data_types/immutable_data.h"
+
+#include "maidsafe/nfs/client_utils.h"
+
+#include "maidsafe/lifestuff/detail/utils.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+ChunkUploader::ChunkUploader(ClientNfs& client_nfs,
+                             PermanentStore& data_store,
+                             const PmidName& pmid_name,
+                             SpaceAccountant& space_accountant,
+                             ChunkFilter& chunk_filter,
+                             NfsScheduler& scheduler,
+                             TokenBucket& bandwidth,
+                             NfsPriority priority,
+                             uint32_t max_in_flight)
+    : client_nfs_(client_nfs),
+      data_store_(data_store),
+      kPmidName_(pmid_name),
+      space_accountant_(space_accountant),
+      chunk_filter_(chunk_filter),
+      scheduler_(scheduler),
+      bandwidth_(bandwidth),
+      kPriority_(priority),
+      kMaxInFlight_(max_in_flight == 0 ? 1 : max_in_flight),
+      in_flight_(0),
+      failed_(false),
+      holding_(false),
+      sent_(),
+      reused_(),
+      replayed_(),
+      offline_journal_(),
+      failure_journal_(),
+      confirmations_(),
+      bytes_uploaded_(0),
+      chunks_uploaded_(0),
+      chunks_resumed_(0),
+      chunks_filtered_(0),
+      chunks_held_(0),
+      chunks_dropped_(0),
+      mutex_(),
+      condition_variable_() {}
+
+void ChunkUploader::Upload(const encrypt::DataMap& data_map,
+                           const std::shared_ptr<UploadJournal>& journal) {
+  Upload(data_map.chunks, journal);
+}
+
+void ChunkUploader::Upload(const std::vector<encrypt::ChunkDetails>& chunks,
+                           const std::shared_ptr<UploadJournal>& journal) {
+  for (auto& chunk : chunks) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!sent_.insert(chunk.hash).second) {
+        if (holding_)
+          reused_.insert(chunk.hash);
+        continue;
+      }
+      if (chunk_filter_.MayContain(chunk.hash)) {
+        ++chunks_filtered_;
+        continue;
+      }
+      // Charged when the interrupted upload first put it.
+      if (journal && journal->Contains(chunk.hash)) {
+        ++chunks_resumed_;
+        continue;
+      }
+      if (!space_accountant_.Reserve(chunk.size)) {
+        sent_.erase(chunk.hash);
+        LOG(kError) << "Storing chunk " << HexSubstr(chunk.hash) << " would exceed the "
+                    << space_accountant_.max_space() << " byte limit.";
+        ThrowError(CommonErrors::cannot_exceed_limit);
+      }
+      if (offline_journal_) {
+        offline_journal_->RecordChunk(chunk.hash, chunk.size);
+        holding_ = true;
+        ++chunks_held_;
+        continue;
+      }
+      condition_variable_.wait(lock, [this] { return in_flight_ < kMaxInFlight_; });
+      ++in_flight_;
+    }
+    Put(chunk.hash, chunk.size, journal);
+  }
+}
+
+void ChunkUploader::Retry(const std::vector<std::string>& chunk_names) {
+  std::vector<encrypt::ChunkDetails> chunks;
+  for (auto& chunk_name : chunk_names) {
+    try {
+      encrypt::ChunkDetails chunk;
+      chunk.hash = chunk_name;
+      chunk.size = static_cast<uint32_t>(
+          data_store_.Get(ImmutableData::name_type(Identity(chunk_name))).string().size());
+      chunks.push_back(chunk);
+    }
+    catch(const std::exception& e) {
+      LOG(kError) << "Can't retry put of chunk " << HexSubstr(chunk_name) << ": " << e.what();
+    }
+  }
+  Upload(chunks);
+}
+
+void ChunkUploader::ForgetStored(const std::vector<encrypt::ChunkDetails>& chunks) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& chunk : chunks) {
+    chunk_filter_.Forget(chunk.hash);
+    sent_.erase(chunk.hash);
+  }
+}
+
+void ChunkUploader::RecordFailuresIn(const std::shared_ptr<UploadJournal>& journal) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  failure_journal_ = journal;
+}
+
+bool ChunkUploader::CanStore(uint64_t bytes) const {
+  return static_cast<int64_t>(bytes) <= space_accountant_.available_space();
+}
+
+void ChunkUploader::WaitForUploads() {
+  std::vector<std::function<void()>> confirmations;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_variable_.wait(lock, [this] { return in_flight_ == 0; });
+    if (failed_) {
+      failed_ = false;
+      confirmations_.clear();
+      ThrowError(LifeStuffErrors::kStoreFailure);
+    }
+    // Held chunks aren't stored yet, so neither is anything registered since they were held.
+    if (holding_)
+      return;
+    confirmations.swap(confirmations_);
+  }
+  for (auto& confirmation : confirmations)
+    confirmation();
+}
+
+void ChunkUploader::OnUploadsConfirmed(const std::function<void()>& functor) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  confirmations_.push_back(functor);
+}
+
+void ChunkUploader::GoOffline(const std::shared_ptr<OfflineJournal>& journal) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  offline_journal_ = journal;
+}
+
+void ChunkUploader::GoOnline() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  offline_journal_.reset();
+}
+
+bool ChunkUploader::Replay(const std::vector<OfflineJournal::Entry>& entries,
+                           const std::function<bool(const std::string&)>& needed) {
+  for (auto& entry : entries) {
+    if (entry.type != OfflineJournal::Entry::Type::kChunk)
+      continue;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (offline_journal_)
+        return false;
+      // A chunk may be recorded more than once, and an earlier replay may not have been confirmed.
+      if (!replayed_.insert(entry.chunk_name).second || chunk_filter_.MayContain(entry.chunk_name))
+        continue;
+      sent_.insert(entry.chunk_name);
+      if (!needed(entry.chunk_name) && reused_.count(entry.chunk_name) == 0) {
+        space_accountant_.Release(entry.size);
+        ++chunks_dropped_;
+        continue;
+      }
+      condition_variable_.wait(lock, [this] { return in_flight_ < kMaxInFlight_; });
+      ++in_flight_;
+    }
+    Put(entry.chunk_name, entry.size, nullptr);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (offline_journal_)
+    return false;
+  holding_ = false;
+  reused_.clear();
+  return true;
+}
+
+void ChunkUploader::Put(const std::string& chunk_name,
+                        uint64_t size,
+                        const std::shared_ptr<UploadJournal>& journal) {
+  std::shared_ptr<PendingPut> pending;
+  try {
+    ImmutableData::name_type name((Identity(chunk_name)));
+    NonEmptyString content(data_store_.Get(name));
+    // The chunk was charged at its plain size, but is compressed before being encrypted, so the
+    // charge is settled to the size actually stored.
+    uint64_t stored_size(content.string().size());
+    space_accountant_.Release(static_cast<int64_t>(size) - static_cast<int64_t>(stored_size));
+    size = stored_size;
+    ImmutableData chunk(name, content);
+    bandwidth_.Consume(size, kPriority_);
+    pending = std::make_shared<PendingPut>(*this, chunk_name, size, journal);
+    ReplyFunction reply([pending] (maidsafe::nfs::Reply reply) {
+                          pending->Complete(reply.IsSuccess());
+                        });
+    maidsafe::nfs::Put<ImmutableData>(client_nfs_, chunk, kPmidName_, 3, reply);
+  }
+  catch(const std::exception& e) {
+    LOG(kError) << "Failed to put chunk " << HexSubstr(chunk_name) << ": " << e.what();
+    if (pending)
+      pending->Complete(false);
+    else
+      OnPutReply(false, chunk_name, size, journal);
+  }
+}
+
+ChunkUploader::PendingPut::PendingPut(ChunkUploader& uploader,
+                                      const std::string& chunk_name,
+                                      uint64_t size,
+                                      const std::shared_ptr<UploadJournal>& journal)
+    : uploader_(uploader),
+      kChunkName_(chunk_name),
+      kSize_(size),
+      kJournal_(journal),
+      slot_(uploader.scheduler_, uploader.kPriority_, size),
+      completed_(false) {}
+
+void ChunkUploader::PendingPut::Complete(bool success) {
+  if (completed_.exchange(true))
+    return;
+  slot_.Release();
+  uploader_.OnPutReply(success, kChunkName_, kSize_, kJournal_);
+}
+
+void ChunkUploader::OnPutReply(bool success,
+                               const std::string& chunk_name,
+                               uint64_t size,
+                               const std::shared_ptr<UploadJournal>& journal) {
+  if (success) {
+    chunk_filter_.Add(chunk_name);
+    if (journal)
+      journal->Record(chunk_name);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+    if (success) {
+      bytes_uploaded_ += size;
+      ++chunks_uploaded_;
+    } else if (offline_journal_) {
+      // Most likely lost with the connection, so held for replay along with later chunks.
+      offline_journal_->RecordChunk(chunk_name, size);
+      replayed_.erase(chunk_name);
+      holding_ = true;
+      ++chunks_held_;
+    } else {
+      LOG(kError) << "Network rejected chunk " << HexSubstr(chunk_name);
+      if (failure_journal_)
+        failure_journal_->Record(chunk_name);
+      space_accountant_.Release(size);
+      sent_.erase(chunk_name);
+      replayed_.erase(chunk_name);
+      failed_ = true;
+    }
+  }
+  condition_variable_.notify_all();
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
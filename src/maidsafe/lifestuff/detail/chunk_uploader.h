@@ -0,0 +1,185 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_UPLOADER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_UPLOADER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "maidsafe/data_store/permanent_store.h"
+
+#include "maidsafe/encrypt/data_map.h"
+
+#include "maidsafe/nfs/nfs.h"
+
+#include "maidsafe/passport/passport.h"
+
+#include "maidsafe/lifestuff/detail/chunk_filter.h"
+#include "maidsafe/lifestuff/detail/nfs_scheduler.h"
+#include "maidsafe/lifestuff/detail/offline_journal.h"
+#include "maidsafe/lifestuff/detail/space_accountant.h"
+#include "maidsafe/lifestuff/detail/token_bucket.h"
+#include "maidsafe/lifestuff/detail/upload_journal.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Stores chunks held in the local PermanentStore on the network.  Puts are issued concurrently,
+// with at most 'max_in_flight' outstanding at any time.  Chunks already put by this uploader are
+// not sent again, nor are chunks which 'chunk_filter' shows as stored by an earlier session; each
+// confirmed put is added to the filter.  Each chunk is charged to 'space_accountant' at its plain
+// size before it is sent, settled to its stored size once read, and refunded if the put fails.
+// Each put is issued once 'bandwidth' allows its size and 'scheduler' grants it a slot in class
+// 'priority'.  While offline, chunks are left in the local store and recorded in a journal
+// instead, to be put in order by Replay once the network returns.  Chunks whose puts fail
+// otherwise are recorded in the journal given to RecordFailuresIn, if any, for Retry to put later.
+class ChunkUploader {
+ public:
+  typedef nfs::ClientMaidNfs ClientNfs;
+  typedef data_store::PermanentStore PermanentStore;
+  typedef passport::Pmid::name_type PmidName;
+
+  ChunkUploader(ClientNfs& client_nfs,
+                PermanentStore& data_store,
+                const PmidName& pmid_name,
+                SpaceAccountant& space_accountant,
+                ChunkFilter& chunk_filter,
+                NfsScheduler& scheduler,
+                TokenBucket& bandwidth,
+                NfsPriority priority,
+                uint32_t max_in_flight);
+  ~ChunkUploader() {}
+
+  // Queues every chunk referenced by 'data_map'.  Blocks while the in-flight window is full.
+  // Throws CommonErrors::cannot_exceed_limit, without sending the remaining chunks, once the
+  // account's space limit would be exceeded.  If 'journal' is given, chunks it already holds are
+  // not sent, and each confirmed put is recorded in it.
+  void Upload(const encrypt::DataMap& data_map,
+              const std::shared_ptr<UploadJournal>& journal = nullptr);
+  // As above, for chunks reported while a file is still being encrypted.
+  void Upload(const std::vector<encrypt::ChunkDetails>& chunks,
+              const std::shared_ptr<UploadJournal>& journal = nullptr);
+  // Queues the chunks named in 'chunk_names', reading their sizes from the local store.  Chunks no
+  // longer held locally are logged and skipped.  Throws as Upload does.
+  void Retry(const std::vector<std::string>& chunk_names);
+  // Stops treating 'chunks' as stored, by this uploader or according to the chunk filter, as the
+  // files referencing them may have been deleted along with them.  They are put when next
+  // uploaded.
+  void ForgetStored(const std::vector<encrypt::ChunkDetails>& chunks);
+  // Records the chunks of any later puts which fail, other than while offline, in 'journal'.
+  void RecordFailuresIn(const std::shared_ptr<UploadJournal>& journal);
+  // Returns false if storing 'bytes' more would certainly exceed the account's space limit.
+  bool CanStore(uint64_t bytes) const;
+  // Blocks until every queued put has been acknowledged.  Throws if any put failed since the last
+  // call.  Otherwise runs, on the calling thread, the functors registered by OnUploadsConfirmed.
+  void WaitForUploads();
+  // Registers 'functor' to be run once every put queued so far has been acknowledged, by the next
+  // call to WaitForUploads which succeeds.  It is discarded if a put fails first.
+  void OnUploadsConfirmed(const std::function<void()>& functor);
+
+  // Until GoOnline is called, chunks are recorded in 'journal' rather than put, as are chunks whose
+  // puts fail in the meantime.  WaitForUploads then returns without running the functors registered
+  // by OnUploadsConfirmed, which wait until a Replay has put every held chunk.
+  void GoOffline(const std::shared_ptr<OfflineJournal>& journal);
+  void GoOnline();
+  // Puts the chunks recorded in 'entries', in order and pipelined up to the in-flight window.
+  // Chunks for which 'needed' returns false are refunded rather than put, unless they have been
+  // uploaded again since being held.  Returns false, leaving the rest, if the uploader goes offline
+  // again first.
+  bool Replay(const std::vector<OfflineJournal::Entry>& entries,
+              const std::function<bool(const std::string&)>& needed);
+
+  // Bytes of chunk content stored, i.e. after the encryptor's compression.
+  uint64_t bytes_uploaded() const { return bytes_uploaded_; }
+  uint64_t chunks_uploaded() const { return chunks_uploaded_; }
+  // Chunks skipped because a journal showed them stored by an earlier, interrupted upload.
+  uint64_t chunks_resumed() const { return chunks_resumed_; }
+  // Chunks skipped because the chunk filter showed them already stored.
+  uint64_t chunks_filtered() const { return chunks_filtered_; }
+  // Chunks recorded in the offline journal, and those a replay found no longer needed.
+  uint64_t chunks_held() const { return chunks_held_; }
+  uint64_t chunks_dropped() const { return chunks_dropped_; }
+
+ private:
+  ChunkUploader(const ChunkUploader&);
+  ChunkUploader& operator=(const ChunkUploader&);
+
+  // Holds a put's scheduler slot and place in the in-flight window.  Shared with the put's reply,
+  // so that if the reply is dropped without being called, e.g. on timing out, the put is treated
+  // as failed rather than holding both forever.
+  class PendingPut {
+   public:
+    PendingPut(ChunkUploader& uploader,
+               const std::string& chunk_name,
+               uint64_t size,
+               const std::shared_ptr<UploadJournal>& journal);
+    ~PendingPut() { Complete(false); }
+    // Releases the slot and reports the result; later calls have no effect.
+    void Complete(bool success);
+
+   private:
+    PendingPut(const PendingPut&);
+    PendingPut& operator=(const PendingPut&);
+
+    ChunkUploader& uploader_;
+    const std::string kChunkName_;
+    const uint64_t kSize_;
+    const std::shared_ptr<UploadJournal> kJournal_;
+    ScopedNfsSlot slot_;
+    std::atomic<bool> completed_;
+  };
+
+  void Put(const std::string& chunk_name,
+           uint64_t size,
+           const std::shared_ptr<UploadJournal>& journal);
+  void OnPutReply(bool success,
+                  const std::string& chunk_name,
+                  uint64_t size,
+                  const std::shared_ptr<UploadJournal>& journal);
+
+  ClientNfs& client_nfs_;
+  PermanentStore& data_store_;
+  const PmidName kPmidName_;
+  SpaceAccountant& space_accountant_;
+  ChunkFilter& chunk_filter_;
+  NfsScheduler& scheduler_;
+  TokenBucket& bandwidth_;
+  const NfsPriority kPriority_;
+  const uint32_t kMaxInFlight_;
+  uint32_t in_flight_;
+  bool failed_, holding_;
+  // 'reused_' holds chunks uploaded again while held; 'replayed_' those a replay has dealt with.
+  std::set<std::string> sent_, reused_, replayed_;
+  std::shared_ptr<OfflineJournal> offline_journal_;
+  std::shared_ptr<UploadJournal> failure_journal_;
+  std::vector<std::function<void()>> confirmations_;
+  std::atomic<uint64_t> bytes_uploaded_, chunks_uploaded_, chunks_resumed_, chunks_filtered_,
+                        chunks_held_, chunks_dropped_;
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_CHUNK_UPLOADER_H_
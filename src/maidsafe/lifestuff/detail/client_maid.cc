@@ -15,6 +15,8 @@ License.
 
 #include "maidsafe/lifestuff/detail/client_maid.h"
 
+#include <memory>
+
 #include "boost/regex.hpp"
 #include "boost/filesystem/path.hpp"
 #include "boost/filesystem/operations.hpp"
@@ -33,11 +35,16 @@ ClientMaid::ClientMaid(Session& session, const Slots& slots)
   : slots_(CheckSlots(slots)),
     session_(session),
     client_controller_(slots_.update_available),
-    user_storage_(),
+    user_storage_(slots_.operations_pending),
     routing_handler_(),
     client_nfs_() {
 }
 
+ClientMaid::~ClientMaid() {
+  // Background flushes still use client_nfs_ and the routing object.
+  user_storage_.WaitForPendingFlush(session_);
+}
+
 void ClientMaid::CreateUser(const Keyword& keyword,
                             const Pin& pin,
                             const Password& password,
@@ -123,6 +130,113 @@ void ClientMaid::UnMountDrive() {
   return;
 }
 
+void ClientMaid::ImportDirectory(const boost::filesystem::path& local_path,
+                                 const boost::filesystem::path& drive_path,
+                                 const TransferProgressFunction& progress) {
+  user_storage_.ImportDirectory(local_path, drive_path, progress);
+  return;
+}
+
+void ClientMaid::ImportFile(const boost::filesystem::path& local_path,
+                            const boost::filesystem::path& drive_path,
+                            const TransferProgressFunction& progress) {
+  user_storage_.ImportFile(local_path, drive_path, progress);
+  return;
+}
+
+void ClientMaid::ExportDirectory(const boost::filesystem::path& drive_path,
+                                 const boost::filesystem::path& local_path,
+                                 const TransferProgressFunction& progress) {
+  user_storage_.ExportDirectory(drive_path, local_path, progress);
+  return;
+}
+
+void ClientMaid::CopyFile(const boost::filesystem::path& source_path,
+                          const boost::filesystem::path& destination_path) {
+  user_storage_.CopyFile(source_path, destination_path);
+  return;
+}
+
+void ClientMaid::AppendToFile(const boost::filesystem::path& drive_path,
+                              const std::string& content) {
+  user_storage_.AppendToFile(drive_path, content);
+  return;
+}
+
+void ClientMaid::TakeSnapshot(const std::string& name) {
+  user_storage_.TakeSnapshot(name, session_);
+  PutSession(session_.keyword(), session_.pin(), session_.password());
+  return;
+}
+
+void ClientMaid::RestoreSnapshot(const std::string& name,
+                                 const boost::filesystem::path& drive_path) {
+  user_storage_.RestoreSnapshot(name, drive_path, session_);
+  return;
+}
+
+void ClientMaid::DeleteSnapshot(const std::string& name) {
+  if (session_.snapshots().count(name) == 0) {
+    LOG(kError) << "No snapshot named \"" << name << "\".";
+    ThrowError(CommonErrors::invalid_parameter);
+  }
+  session_.RemoveSnapshot(name);
+  PutSession(session_.keyword(), session_.pin(), session_.password());
+  return;
+}
+
+std::vector<DirectoryEntry> ClientMaid::ListDirectory(const boost::filesystem::path& drive_path,
+                                                      const std::string& start_after,
+                                                      size_t max_entries) {
+  return user_storage_.ListDirectory(drive_path, start_after, max_entries);
+}
+
+int64_t ClientMaid::used_space() {
+  if (user_storage_.mount_status())
+    return user_storage_.used_space();
+  user_storage_.WaitForPendingFlush(session_);
+  return session_.used_space();
+}
+
+int64_t ClientMaid::max_space() {
+  if (user_storage_.mount_status())
+    return user_storage_.max_space();
+  user_storage_.WaitForPendingFlush(session_);
+  return session_.max_space();
+}
+
+void ClientMaid::SetBandwidthLimits(uint64_t upload_bytes_per_second,
+                                    uint64_t download_bytes_per_second) {
+  user_storage_.shared_resources()->SetBandwidthLimits(upload_bytes_per_second,
+                                                       download_bytes_per_second);
+}
+
+void ClientMaid::PinPath(const boost::filesystem::path& drive_path) {
+  user_storage_.PinPath(drive_path);
+}
+
+void ClientMaid::UnpinPath(const boost::filesystem::path& drive_path) {
+  user_storage_.UnpinPath(drive_path);
+}
+
+std::vector<std::string> ClientMaid::PinnedPaths() {
+  std::vector<std::string> paths;
+  for (auto& path : user_storage_.PinnedPaths())
+    paths.push_back(path.generic_string());
+  return paths;
+}
+
+uint64_t ClientMaid::pinned_space() {
+  return user_storage_.pinned_space();
+}
+
+std::vector<std::string> ClientMaid::ListSnapshots() const {
+  std::vector<std::string> names;
+  for (auto& snapshot : session_.snapshots())
+    names.push_back(snapshot.first);
+  return names;
+}
+
 void ClientMaid::ChangeKeyword(const Keyword& old_keyword,
                                const Keyword& new_keyword,
                                const Pin& pin,
@@ -167,6 +281,8 @@ const Slots& ClientMaid::CheckSlots(const Slots& slots) {
 }
 
 void ClientMaid::PutSession(const Keyword& keyword, const Pin& pin, const Password& password) {
+  // Space figures in the session are only final once any background unmount has completed.
+  user_storage_.WaitForPendingFlush(session_);
   NonEmptyString serialised_session(session_.Serialise());
   passport::EncryptedSession encrypted_session(passport::EncryptSession(
                                                   keyword, pin, password, serialised_session));
@@ -181,8 +297,10 @@ void ClientMaid::PutSession(const Keyword& keyword, const Pin& pin, const Passwo
 
 void ClientMaid::DeleteSession(const Keyword& keyword, const Pin& pin) {
   Mid::name_type mid_name(Mid::GenerateName(keyword, pin));
+  ScopedNfsSlot slot(nfs_scheduler(), NfsPriority::kSessionCritical, 0);
   auto mid_future(maidsafe::nfs::Get<Mid>(*client_nfs_, mid_name));
   Mid mid(*mid_future.get());
+  slot.Release();
   passport::EncryptedTmidName encrypted_tmid_name(mid.encrypted_tmid_name());
   Tmid::name_type tmid_name(passport::DecryptTmidName(keyword, pin, encrypted_tmid_name));
   DeleteFob<Tmid>(tmid_name);
@@ -191,12 +309,15 @@ void ClientMaid::DeleteSession(const Keyword& keyword, const Pin& pin) {
 
 void ClientMaid::GetSession(const Keyword& keyword, const Pin& pin, const Password& password) {
   Mid::name_type mid_name(Mid::GenerateName(keyword, pin));
+  // The two gets are dependent, so share one slot.
+  ScopedNfsSlot slot(nfs_scheduler(), NfsPriority::kSessionCritical, 0);
   auto mid_future(maidsafe::nfs::Get<Mid>(*client_nfs_, mid_name));
   Mid mid(*mid_future.get());
   passport::EncryptedTmidName encrypted_tmid_name(mid.encrypted_tmid_name());
   Tmid::name_type tmid_name(passport::DecryptTmidName(keyword, pin, encrypted_tmid_name));
   auto tmid_future(maidsafe::nfs::Get<Tmid>(*client_nfs_, tmid_name));
   Tmid tmid(*tmid_future.get());
+  slot.Release();
   passport::EncryptedSession encrypted_session(tmid.encrypted_session());
   NonEmptyString serialised_session(passport::DecryptSession(
                                       keyword, pin, password, encrypted_session));
@@ -205,11 +326,16 @@ void ClientMaid::GetSession(const Keyword& keyword, const Pin& pin, const Passwo
 }
 
 void ClientMaid::JoinNetwork(const Maid& maid) {
+  user_storage_.WaitForPendingFlush(session_);
   PublicKeyRequestFunction public_key_request(
       [this](const NodeId& node_id, const GivePublicKeyFunctor& give_key) {
         PublicKeyRequest(node_id, give_key);
       });
-  routing_handler_.reset(new RoutingHandler(maid, public_key_request));
+  NetworkHealthFunction network_health([this](int32_t network_health) {
+                                         user_storage_.OnNetworkHealthChange(network_health);
+                                         slots_.network_health(network_health);
+                                       });
+  routing_handler_.reset(new RoutingHandler(maid, public_key_request, network_health));
 
   std::vector<boost::asio::ip::udp::endpoint> bootstrap_endpoints;
   client_controller_.GetBootstrapNodes(bootstrap_endpoints);
@@ -257,7 +383,12 @@ void ClientMaid::UnCreateUser(bool fobs_confirmed, bool drive_mounted) {
 
 template<typename Fob>
 void ClientMaid::PutFob(const Fob& fob) {
-  ReplyFunction reply([this] (maidsafe::nfs::Reply reply) {
+  // Shared with the reply, so that the slot is also released if the put throws or the reply
+  // is dropped without being called.
+  std::shared_ptr<ScopedNfsSlot> slot(std::make_shared<ScopedNfsSlot>(
+      nfs_scheduler(), NfsPriority::kSessionCritical, 0));
+  ReplyFunction reply([slot] (maidsafe::nfs::Reply reply) {
+                        slot->Release();
                         if (!reply.IsSuccess()) {
                           ThrowError(LifeStuffErrors::kStoreFailure);
                         }
@@ -269,7 +400,11 @@ void ClientMaid::PutFob(const Fob& fob) {
 
 template<typename Fob>
 void ClientMaid::DeleteFob(const typename Fob::name_type& fob_name) {
-  ReplyFunction reply([this] (maidsafe::nfs::Reply reply) {
+  // As for PutFob, the reply shares the slot.
+  std::shared_ptr<ScopedNfsSlot> slot(std::make_shared<ScopedNfsSlot>(
+      nfs_scheduler(), NfsPriority::kSessionCritical, 0));
+  ReplyFunction reply([slot] (maidsafe::nfs::Reply reply) {
+                        slot->Release();
                         if (!reply.IsSuccess()) {
                           ThrowError(LifeStuffErrors::kDeleteFailure);
                         }
@@ -280,6 +415,7 @@ void ClientMaid::DeleteFob(const typename Fob::name_type& fob_name) {
 
 template<typename Fob>
 Fob ClientMaid::GetFob(const typename Fob::name_type& fob_name) {
+  ScopedNfsSlot slot(nfs_scheduler(), NfsPriority::kSessionCritical, 0);
   std::future<Fob> fob_future(maidsafe::nfs::Get<Fob>(*client_nfs_, fob_name));
   return fob_future.get();
 }
@@ -308,6 +444,7 @@ void ClientMaid::PublicKeyRequest(const NodeId& node_id, const GivePublicKeyFunc
   if (client_nfs_) {
     typedef passport::PublicPmid PublicPmid;
     PublicPmid::name_type pmid_name(Identity(node_id.string()));
+    ScopedNfsSlot slot(nfs_scheduler(), NfsPriority::kInteractive, 0);
     auto pmid_future(maidsafe::nfs::Get<PublicPmid>(*client_nfs_, pmid_name));
     give_key(pmid_future.get()->public_key());
   } else {
@@ -316,5 +453,9 @@ void ClientMaid::PublicKeyRequest(const NodeId& node_id, const GivePublicKeyFunc
   return;
 }
 
+NfsScheduler& ClientMaid::nfs_scheduler() {
+  return user_storage_.shared_resources()->nfs_scheduler();
+}
+
 }  // lifestuff
 }  // maidsafe
@@ -16,6 +16,9 @@ License.
 #ifndef MAIDSAFE_LIFESTUFF_DETAIL_CLIENT_MAID_H_
 #define MAIDSAFE_LIFESTUFF_DETAIL_CLIENT_MAID_H_
 
+#include <string>
+#include <vector>
+
 #include "maidsafe/routing/routing_api.h"
 
 #include "maidsafe/nfs/nfs.h"
@@ -49,7 +52,7 @@ class ClientMaid {
   typedef passport::Tmid Tmid;
 
   ClientMaid(Session& session, const Slots& slots);
-  ~ClientMaid() {}
+  ~ClientMaid();
 
   void CreateUser(const Keyword& keyword,
                   const Pin& pin,
@@ -64,6 +67,32 @@ class ClientMaid {
   void LogOut();
   void MountDrive();
   void UnMountDrive();
+  void ImportDirectory(const boost::filesystem::path& local_path,
+                       const boost::filesystem::path& drive_path,
+                       const TransferProgressFunction& progress);
+  void ImportFile(const boost::filesystem::path& local_path,
+                  const boost::filesystem::path& drive_path,
+                  const TransferProgressFunction& progress);
+  void ExportDirectory(const boost::filesystem::path& drive_path,
+                       const boost::filesystem::path& local_path,
+                       const TransferProgressFunction& progress);
+  void CopyFile(const boost::filesystem::path& source_path,
+                const boost::filesystem::path& destination_path);
+  void AppendToFile(const boost::filesystem::path& drive_path, const std::string& content);
+  void TakeSnapshot(const std::string& name);
+  void RestoreSnapshot(const std::string& name, const boost::filesystem::path& drive_path);
+  void DeleteSnapshot(const std::string& name);
+  std::vector<std::string> ListSnapshots() const;
+  std::vector<DirectoryEntry> ListDirectory(const boost::filesystem::path& drive_path,
+                                            const std::string& start_after,
+                                            size_t max_entries);
+  int64_t used_space();
+  int64_t max_space();
+  void SetBandwidthLimits(uint64_t upload_bytes_per_second, uint64_t download_bytes_per_second);
+  void PinPath(const boost::filesystem::path& drive_path);
+  void UnpinPath(const boost::filesystem::path& drive_path);
+  std::vector<std::string> PinnedPaths();
+  uint64_t pinned_space();
 
   void ChangeKeyword(const Keyword& old_keyword,
                      const Keyword& new_keyword,
@@ -98,6 +127,8 @@ class ClientMaid {
   void PutPaidFobs();
 
   void PublicKeyRequest(const NodeId& node_id, const GivePublicKeyFunctor& give_key);
+  // Session operations share the scheduler with every mount's transfers; see NfsScheduler.
+  NfsScheduler& nfs_scheduler();
 
   Slots slots_;
   Session& session_;
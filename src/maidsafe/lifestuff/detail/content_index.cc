@@ -0,0 +1,164 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/content_index.h"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/lifestuff/detail/data_atlas.pb.h"
+#include "maidsafe/lifestuff/detail/encrypted_file.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+std::string DataMapKey(const std::string& serialised_data_map) {
+  return crypto::Hash<crypto::SHA512>(serialised_data_map).string();
+}
+
+}  // unnamed namespace
+
+ContentIndex::ContentIndex(size_t capacity)
+    : kCapacity_(capacity == 0 ? 1 : capacity),
+      entries_(),
+      content_sizes_(),
+      content_hashes_(),
+      mutex_() {}
+
+bool ContentIndex::Load(const fs::path& index_path, const Identity& secret) {
+  std::map<std::string, Entry> entries;
+  std::map<uint64_t, size_t> content_sizes;
+  std::map<std::string, std::string> content_hashes;
+  try {
+    ContentIndexData index_data;
+    if (!index_data.ParseFromString(ReadEncryptedFile(index_path, secret, "content index"))) {
+      LOG(kWarning) << "Failed to parse content index at " << index_path;
+      return false;
+    }
+    for (int i(0); i != index_data.entries_size(); ++i) {
+      const ContentIndexData::Entry& entry(index_data.entries(i));
+      // Entries saved before sizes were recorded would never be looked up, so are dropped.
+      if (entry.content_size() == 0 ||
+          !entries.insert(std::make_pair(entry.content_hash(),
+                                         Entry(entry.content_size(),
+                                               entry.serialised_data_map()))).second) {
+        continue;
+      }
+      ++content_sizes[entry.content_size()];
+      content_hashes[DataMapKey(entry.serialised_data_map())] = entry.content_hash();
+    }
+  }
+  catch(const std::exception& e) {
+    LOG(kInfo) << "No usable content index at " << index_path << ": " << e.what();
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.swap(entries);
+  content_sizes_.swap(content_sizes);
+  content_hashes_.swap(content_hashes);
+  return true;
+}
+
+void ContentIndex::Save(const fs::path& index_path, const Identity& secret) const {
+  ContentIndexData index_data;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& indexed : entries_) {
+      ContentIndexData::Entry* entry(index_data.add_entries());
+      entry->set_content_hash(indexed.first);
+      entry->set_serialised_data_map(indexed.second.serialised_data_map);
+      entry->set_content_size(indexed.second.content_size);
+    }
+  }
+  WriteEncryptedFile(index_path, secret, "content index", index_data.SerializeAsString());
+}
+
+bool ContentIndex::Find(const std::string& content_hash,
+                        std::string* serialised_data_map) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(entries_.find(content_hash));
+  if (itr == entries_.end())
+    return false;
+  *serialised_data_map = itr->second.serialised_data_map;
+  return true;
+}
+
+bool ContentIndex::MayContainSize(uint64_t content_size) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return content_sizes_.count(content_size) != 0;
+}
+
+void ContentIndex::Add(const std::string& content_hash,
+                       uint64_t content_size,
+                       const std::string& serialised_data_map) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto existing(entries_.find(content_hash));
+  if (existing != entries_.end()) {
+    Erase(existing);
+  } else if (entries_.size() >= kCapacity_) {
+    // Content hashes are uniformly distributed, so the successor of a new hash is a random entry.
+    auto victim(entries_.upper_bound(content_hash));
+    Erase(victim == entries_.end() ? entries_.begin() : victim);
+  }
+  entries_.insert(std::make_pair(content_hash, Entry(content_size, serialised_data_map)));
+  ++content_sizes_[content_size];
+  content_hashes_[DataMapKey(serialised_data_map)] = content_hash;
+}
+
+void ContentIndex::Remove(const std::string& content_hash) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(entries_.find(content_hash));
+  if (itr != entries_.end())
+    Erase(itr);
+}
+
+void ContentIndex::RemoveDataMap(const std::string& serialised_data_map) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto content_hash(content_hashes_.find(DataMapKey(serialised_data_map)));
+  if (content_hash == content_hashes_.end())
+    return;
+  auto itr(entries_.find(content_hash->second));
+  if (itr != entries_.end())
+    Erase(itr);
+}
+
+void ContentIndex::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  content_sizes_.clear();
+  content_hashes_.clear();
+}
+
+size_t ContentIndex::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+void ContentIndex::Erase(std::map<std::string, Entry>::iterator itr) {
+  auto content_size(content_sizes_.find(itr->second.content_size));
+  if (--content_size->second == 0)
+    content_sizes_.erase(content_size);
+  auto content_hash(content_hashes_.find(DataMapKey(itr->second.serialised_data_map)));
+  if (content_hash != content_hashes_.end() && content_hash->second == itr->first)
+    content_hashes_.erase(content_hash);
+  entries_.erase(itr);
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
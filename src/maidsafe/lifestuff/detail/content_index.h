@@ -0,0 +1,89 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_CONTENT_INDEX_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_CONTENT_INDEX_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Maps the hash of a file's content to the serialised data map it self-encrypted to.  As
+// self-encryption is deterministic, a file whose content is indexed can be added to the drive by
+// reusing that data map, without encrypting or uploading anything.  Only data maps whose chunks
+// have all been confirmed stored should be added.  Once 'capacity' entries are held, adding one
+// evicts another at random.  The index can be saved to and loaded from an encrypted file.  The
+// size of each entry's content is kept too, so that callers need only hash content of a size
+// which might be indexed.  Entries whose data maps are replaced in the drive should be removed, as
+// their chunks may have been deleted with them.
+class ContentIndex {
+ public:
+  explicit ContentIndex(size_t capacity);
+  ~ContentIndex() {}
+
+  // Replaces the index with the one saved at 'index_path'.  Returns false, leaving the index empty,
+  // if there is no saved index or it can't be decrypted with 'secret'.
+  bool Load(const boost::filesystem::path& index_path, const Identity& secret);
+  void Save(const boost::filesystem::path& index_path, const Identity& secret) const;
+
+  bool Find(const std::string& content_hash, std::string* serialised_data_map) const;
+  // Returns false if no indexed content is 'content_size' bytes long.
+  bool MayContainSize(uint64_t content_size) const;
+  void Add(const std::string& content_hash,
+           uint64_t content_size,
+           const std::string& serialised_data_map);
+  void Remove(const std::string& content_hash);
+  // Removes the entry, if any, whose data map is 'serialised_data_map'.
+  void RemoveDataMap(const std::string& serialised_data_map);
+  void Clear();
+
+  size_t size() const;
+
+ private:
+  ContentIndex(const ContentIndex&);
+  ContentIndex& operator=(const ContentIndex&);
+
+  struct Entry {
+    Entry() : content_size(0), serialised_data_map() {}
+    Entry(uint64_t content_size_in, const std::string& serialised_data_map_in)
+        : content_size(content_size_in),
+          serialised_data_map(serialised_data_map_in) {}
+    uint64_t content_size;
+    std::string serialised_data_map;
+  };
+
+  void Erase(std::map<std::string, Entry>::iterator itr);
+
+  const size_t kCapacity_;
+  std::map<std::string, Entry> entries_;
+  // Number of entries of each content size.
+  std::map<uint64_t, size_t> content_sizes_;
+  // Content hash of each entry, keyed by the hash of its data map.
+  std::map<std::string, std::string> content_hashes_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_CONTENT_INDEX_H_
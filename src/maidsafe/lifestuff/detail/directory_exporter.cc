@@ -0,0 +1,145 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/directory_exporter.h"
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/lifestuff/detail/file_encryptor.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+DirectoryExporter::DirectoryExporter(PermanentStore& data_store,
+                                     ChunkFetcher& chunk_fetcher,
+                                     boost::asio::io_service& io_service,
+                                     const MountProfile& profile)
+    : data_store_(data_store),
+      chunk_fetcher_(chunk_fetcher),
+      kBlockSize_(profile.max_write_size),
+      task_group_(io_service, profile.worker_count),
+      local_root_(),
+      get_data_map_(),
+      progress_(),
+      completed_(),
+      manifest_(),
+      total_bytes_(0),
+      done_bytes_(0),
+      manifest_mutex_(),
+      progress_mutex_() {}
+
+void DirectoryExporter::Export(const fs::path& drive_root,
+                               const fs::path& local_path,
+                               const GetDataMapFunctor& get_data_map,
+                               const TransferProgressFunction& progress) {
+  local_root_ = local_path;
+  get_data_map_ = get_data_map;
+  progress_ = progress;
+
+  std::vector<fs::path> directories;
+  std::vector<FileEntry> files;
+  fs::recursive_directory_iterator itr(drive_root), end;
+  for (; itr != end; ++itr) {
+    fs::path relative_path(itr->path().string().substr(drive_root.string().size() + 1));
+    if (fs::is_directory(itr->status())) {
+      directories.push_back(relative_path);
+    } else if (fs::is_regular_file(itr->status())) {
+      files.push_back(std::make_pair(relative_path, fs::file_size(itr->path())));
+      total_bytes_ += files.back().second;
+    }
+  }
+
+  boost::system::error_code error_code;
+  fs::create_directories(local_root_, error_code);
+  for (auto& directory : directories)
+    fs::create_directories(local_root_ / directory, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to create directories under " << local_root_ << ": "
+                << error_code.message();
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+
+  ReadManifest();
+  manifest_.open(local_root_ / kExportManifestName, std::ios_base::out | std::ios_base::app);
+  if (progress_)
+    progress_(0, total_bytes_);
+  for (auto& file : files)
+    task_group_.Post([this, file] { ExportFile(file); });
+  task_group_.Wait();
+  manifest_.close();
+  fs::remove(local_root_ / kExportManifestName, error_code);
+}
+
+void DirectoryExporter::ReadManifest() {
+  fs::ifstream manifest(local_root_ / kExportManifestName);
+  std::string line;
+  while (std::getline(manifest, line)) {
+    size_t separator(line.find(' '));
+    if (separator == std::string::npos)
+      continue;
+    completed_[line.substr(separator + 1)] = line.substr(0, separator);
+  }
+  if (!completed_.empty())
+    LOG(kInfo) << "Resuming export to " << local_root_ << ", " << completed_.size()
+               << " files already complete.";
+}
+
+void DirectoryExporter::ExportFile(const FileEntry& file) {
+  fs::path local_file(local_root_ / file.first);
+  if (file.second == 0) {
+    fs::ofstream empty_file(local_file, std::ios_base::out | std::ios_base::trunc);
+    return ReportProgress(0);
+  }
+
+  std::string serialised_data_map(get_data_map_(file.first));
+  std::string hash(EncodeToHex(crypto::Hash<crypto::SHA512>(serialised_data_map)));
+  auto completed(completed_.find(file.first.generic_string()));
+  boost::system::error_code error_code;
+  if (completed != completed_.end() && completed->second == hash &&
+      fs::file_size(local_file, error_code) == file.second && !error_code) {
+    return ReportProgress(file.second);
+  }
+
+  encrypt::DataMapPtr data_map(ParseDataMap(serialised_data_map));
+  chunk_fetcher_.ReadThrough(*data_map, [&] {
+                               DecryptFile(data_map, data_store_, local_file, kBlockSize_);
+                             });
+  RecordInManifest(file.first, hash);
+  ReportProgress(file.second);
+}
+
+void DirectoryExporter::RecordInManifest(const fs::path& relative_path,
+                                         const std::string& hash) {
+  std::lock_guard<std::mutex> lock(manifest_mutex_);
+  manifest_ << hash << ' ' << relative_path.generic_string() << std::endl;
+}
+
+void DirectoryExporter::ReportProgress(uint64_t bytes) {
+  done_bytes_ += bytes;
+  if (!progress_)
+    return;
+  // As for imports, the count is read under the lock so that reports never go backwards.
+  std::lock_guard<std::mutex> lock(progress_mutex_);
+  progress_(done_bytes_, total_bytes_);
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,97 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_DIRECTORY_EXPORTER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_DIRECTORY_EXPORTER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/data_store/permanent_store.h"
+
+#include "maidsafe/lifestuff/lifestuff.h"
+#include "maidsafe/lifestuff/detail/chunk_fetcher.h"
+#include "maidsafe/lifestuff/detail/mount_profile.h"
+#include "maidsafe/lifestuff/detail/task_group.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Name of the manifest written to the root of an export's destination while it is in progress.
+const char kExportManifestName[] = ".lifestuff_export";
+
+// Restores a drive subtree to local disk.  The whole subtree is listed up front, then files are
+// exported in parallel on the worker pool, with the ChunkFetcher bounding the number of chunk gets
+// in flight across all files.  Each completed file is recorded in a manifest in the destination
+// so that an interrupted export resumes from where it stopped.
+class DirectoryExporter {
+ public:
+  typedef data_store::PermanentStore PermanentStore;
+  // Returns the serialised data map of the file at the given path, relative to the export source.
+  typedef std::function<std::string(const boost::filesystem::path&)> GetDataMapFunctor;
+
+  DirectoryExporter(PermanentStore& data_store,
+                    ChunkFetcher& chunk_fetcher,
+                    boost::asio::io_service& io_service,
+                    const MountProfile& profile);
+  ~DirectoryExporter() {}
+
+  // Exports the tree under the mounted directory 'drive_root' into 'local_path'.  Blocks until
+  // complete and throws the first error encountered by any worker, leaving the manifest in place.
+  void Export(const boost::filesystem::path& drive_root,
+              const boost::filesystem::path& local_path,
+              const GetDataMapFunctor& get_data_map,
+              const TransferProgressFunction& progress);
+
+ private:
+  DirectoryExporter(const DirectoryExporter&);
+  DirectoryExporter& operator=(const DirectoryExporter&);
+
+  typedef std::pair<boost::filesystem::path, uint64_t> FileEntry;
+
+  void ReadManifest();
+  void ExportFile(const FileEntry& file);
+  void RecordInManifest(const boost::filesystem::path& relative_path, const std::string& hash);
+  // Calls 'progress_' with the running total.  Workers' calls are serialised.
+  void ReportProgress(uint64_t bytes);
+
+  PermanentStore& data_store_;
+  ChunkFetcher& chunk_fetcher_;
+  const uint32_t kBlockSize_;
+  TaskGroup task_group_;
+  boost::filesystem::path local_root_;
+  GetDataMapFunctor get_data_map_;
+  TransferProgressFunction progress_;
+  std::map<std::string, std::string> completed_;
+  boost::filesystem::ofstream manifest_;
+  uint64_t total_bytes_;
+  std::atomic<uint64_t> done_bytes_;
+  std::mutex manifest_mutex_, progress_mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_DIRECTORY_EXPORTER_H_
@@ -0,0 +1,292 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/directory_importer.h"
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+const size_t kCommitBatchSize(64);
+// Files of at least this size are encrypted with the encryptor's own parallelism and uploaded as
+// their chunks are produced.  Smaller files gain more from being spread across workers.
+const uint64_t kLargeFileSize(64 * 1024 * 1024);
+// Files of at least this size have their compressibility sampled when checking that an import
+// will fit in the account's remaining space.
+const uint64_t kSampledFileSize(16 * 1024 * 1024);
+
+}  // unnamed namespace
+
+DirectoryImporter::DirectoryImporter(PermanentStore& data_store,
+                                     ChunkUploader& chunk_uploader,
+                                     boost::asio::io_service& io_service,
+                                     const MountProfile& profile,
+                                     const fs::path& journal_directory,
+                                     ContentIndex& content_index)
+    : data_store_(data_store),
+      chunk_uploader_(chunk_uploader),
+      content_index_(content_index),
+      kBlockSize_(profile.max_read_size),
+      kEncryptorThreads_(static_cast<int>(profile.worker_count)),
+      kMaxInlineFileSize_(profile.max_inline_file_size),
+      kJournalDirectory_(journal_directory),
+      kWaitForUploads_(profile.durability_mode == DurabilityMode::kWriteThrough),
+      task_group_(io_service, profile.worker_count),
+      local_root_(),
+      commit_(),
+      progress_(),
+      directories_(),
+      files_(),
+      batch_(),
+      journals_(),
+      uploaded_content_(),
+      total_bytes_(0),
+      done_bytes_(0),
+      mutex_(),
+      commit_mutex_(),
+      progress_mutex_() {}
+
+void DirectoryImporter::Import(const fs::path& local_path,
+                               const CreateDirectoryFunctor& create_directory,
+                               const CommitFunctor& commit,
+                               const TransferProgressFunction& progress) {
+  boost::system::error_code error_code;
+  if (!fs::is_directory(local_path, error_code)) {
+    LOG(kError) << local_path << " is not a directory.";
+    ThrowError(CommonErrors::invalid_parameter);
+  }
+  local_root_ = local_path;
+  commit_ = commit;
+  progress_ = progress;
+
+  // Walk the source tree.  Each directory listing is a separate task, so wide trees are listed in
+  // parallel.
+  task_group_.Post([this] { ListDirectory(fs::path()); });
+  task_group_.Wait();
+
+  // An import estimated to need more than the remaining allowance is refused before any
+  // encryption or upload starts.  The uploader still enforces the limit chunk by chunk.
+  uint64_t estimated_bytes(0);
+  for (auto& file : files_) {
+    total_bytes_ += file.second;
+    estimated_bytes += EstimateStoredSize(local_root_ / file.first, file.second);
+  }
+  if (!chunk_uploader_.CanStore(estimated_bytes)) {
+    LOG(kError) << "Importing " << total_bytes_ << " bytes from " << local_root_ << ", estimated "
+                << estimated_bytes << " once compressed, would exceed the account's space limit.";
+    ThrowError(CommonErrors::cannot_exceed_limit);
+  }
+
+  // std::set orders parents before their children.
+  for (auto& directory : directories_)
+    create_directory(directory);
+
+  if (progress_)
+    progress_(0, total_bytes_);
+  for (auto& file : files_)
+    task_group_.Post([this, file] { ImportEntry(file); });
+  task_group_.Wait();
+  CommitBatch();
+  FinishUploads();
+}
+
+void DirectoryImporter::ListDirectory(const fs::path& relative_path) {
+  std::vector<fs::path> subdirectories;
+  std::vector<FileEntry> files;
+  fs::directory_iterator end;
+  for (fs::directory_iterator itr(local_root_ / relative_path); itr != end; ++itr) {
+    fs::file_status status(itr->symlink_status());
+    if (fs::is_directory(status)) {
+      subdirectories.push_back(relative_path / itr->path().filename());
+    } else if (fs::is_regular_file(status)) {
+      files.push_back(std::make_pair(relative_path / itr->path().filename(),
+                                     fs::file_size(itr->path())));
+    } else {
+      LOG(kWarning) << "Skipping " << itr->path() << ", not a regular file or directory.";
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    directories_.insert(subdirectories.begin(), subdirectories.end());
+    files_.insert(files_.end(), files.begin(), files.end());
+  }
+  for (auto& subdirectory : subdirectories)
+    task_group_.Post([this, subdirectory] { ListDirectory(subdirectory); });
+}
+
+std::string DirectoryImporter::ImportFile(const fs::path& local_file,
+                                          const TransferProgressFunction& progress) {
+  boost::system::error_code error_code;
+  uint64_t size(fs::file_size(local_file, error_code));
+  if (error_code || !fs::is_regular_file(local_file, error_code)) {
+    LOG(kError) << local_file << " is not a regular file.";
+    ThrowError(CommonErrors::invalid_parameter);
+  }
+  if (!chunk_uploader_.CanStore(EstimateStoredSize(local_file, size))) {
+    LOG(kError) << "Importing " << size << " bytes from " << local_file
+                << " would exceed the account's space limit.";
+    ThrowError(CommonErrors::cannot_exceed_limit);
+  }
+  progress_ = progress;
+  total_bytes_ = size;
+  if (progress_)
+    progress_(0, total_bytes_);
+  encrypt::DataMapPtr data_map(EncryptAndUpload(local_file, size));
+  FinishUploads();
+  return SerialiseDataMap(*data_map);
+}
+
+uint64_t DirectoryImporter::EstimateStoredSize(const fs::path& local_file, uint64_t size) const {
+  if (size <= kMaxInlineFileSize_)
+    return 0;
+  if (size < kSampledFileSize)
+    return size;
+  return static_cast<uint64_t>(static_cast<double>(size) * EstimateStoredRatio(local_file, size));
+}
+
+void DirectoryImporter::ImportEntry(const FileEntry& file) {
+  encrypt::DataMapPtr data_map(EncryptAndUpload(local_root_ / file.first, file.second));
+  AddToBatch(std::make_pair(file.first, SerialiseDataMap(*data_map)));
+}
+
+encrypt::DataMapPtr DirectoryImporter::EncryptAndUpload(const fs::path& local_file,
+                                                        uint64_t size) {
+  if (size <= kMaxInlineFileSize_) {
+    ReportProgress(size);
+    return InlineFile(local_file);
+  }
+  boost::system::error_code error_code;
+  std::time_t last_write_time(fs::last_write_time(local_file, error_code));
+  // Hashing up front reads the whole file, so is only done if indexed content might match.
+  // Otherwise the hash is taken while the file is read for encryption.
+  std::string content_hash;
+  if (content_index_.MayContainSize(size)) {
+    content_hash = crypto::HashFile<crypto::SHA512>(local_file).string();
+    std::string serialised_data_map;
+    if (content_index_.Find(content_hash, &serialised_data_map)) {
+      encrypt::DataMapPtr data_map(ParseDataMap(serialised_data_map));
+      if (HoldsChunks(data_store_, *data_map)) {
+        // Puts any chunks the uploader no longer knows to be stored.
+        chunk_uploader_.Upload(*data_map);
+        ReportProgress(size);
+        return data_map;
+      }
+      LOG(kWarning) << "Indexed content of " << local_file << " is no longer held.";
+      content_index_.Remove(content_hash);
+      chunk_uploader_.ForgetStored(data_map->chunks);
+    }
+  }
+
+  encrypt::DataMapPtr data_map;
+  std::shared_ptr<UploadJournal> journal;
+  uint64_t reported(0);
+  std::string* hash_while_encrypting(content_hash.empty() ? &content_hash : nullptr);
+  if (size < kLargeFileSize) {
+    data_map = EncryptFile(local_file, data_store_, 0, kBlockSize_, nullptr,
+                           hash_while_encrypting);
+  } else {
+    journal = OpenJournal(local_file, size);
+    data_map = EncryptFile(local_file, data_store_, kEncryptorThreads_, kBlockSize_,
+                           [&](const std::vector<encrypt::ChunkDetails>& chunks) {
+                             chunk_uploader_.Upload(chunks, journal);
+                             uint64_t bytes(0);
+                             for (auto& chunk : chunks)
+                               bytes += chunk.size;
+                             reported += bytes;
+                             ReportProgress(bytes);
+                           },
+                           hash_while_encrypting);
+  }
+  chunk_uploader_.Upload(*data_map, journal);
+  ReportProgress(size > reported ? size - reported : 0);
+  // A file modified while it was being read may no longer match the hash taken beforehand.
+  if (!error_code && fs::last_write_time(local_file, error_code) == last_write_time &&
+      !error_code) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uploaded_content_.push_back(UploadedContent(content_hash, size, SerialiseDataMap(*data_map)));
+  }
+  return data_map;
+}
+
+std::shared_ptr<UploadJournal> DirectoryImporter::OpenJournal(const fs::path& local_file,
+                                                              uint64_t size) {
+  // Keyed on the file's identity and version, so a modified file starts a fresh journal.
+  boost::system::error_code error_code;
+  std::string key(fs::absolute(local_file).string() + ':' + std::to_string(size) + ':' +
+                  std::to_string(fs::last_write_time(local_file, error_code)));
+  std::shared_ptr<UploadJournal> journal(std::make_shared<UploadJournal>(
+      kJournalDirectory_ / EncodeToHex(crypto::Hash<crypto::SHA512>(key)).substr(0, 32)));
+  std::lock_guard<std::mutex> lock(mutex_);
+  journals_.push_back(journal);
+  return journal;
+}
+
+void DirectoryImporter::FinishUploads() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::shared_ptr<UploadJournal>> journals;
+    std::vector<UploadedContent> uploaded_content;
+    journals.swap(journals_);
+    uploaded_content.swap(uploaded_content_);
+    ContentIndex& content_index(content_index_);
+    chunk_uploader_.OnUploadsConfirmed([journals, uploaded_content, &content_index] {
+      for (auto& journal : journals)
+        journal->Complete();
+      for (auto& content : uploaded_content)
+        content_index.Add(content.content_hash, content.content_size, content.serialised_data_map);
+    });
+  }
+  if (kWaitForUploads_)
+    chunk_uploader_.WaitForUploads();
+}
+
+void DirectoryImporter::ReportProgress(uint64_t bytes) {
+  done_bytes_ += bytes;
+  if (!progress_)
+    return;
+  // Reading the count under the lock, rather than taking it from the addition, means a worker
+  // which is overtaken reports the later count instead of going backwards.
+  std::lock_guard<std::mutex> lock(progress_mutex_);
+  progress_(done_bytes_, total_bytes_);
+}
+
+void DirectoryImporter::AddToBatch(const DataMapEntry& entry) {
+  std::lock_guard<std::mutex> lock(commit_mutex_);
+  batch_.push_back(entry);
+  if (batch_.size() >= kCommitBatchSize) {
+    commit_(batch_);
+    batch_.clear();
+  }
+}
+
+void DirectoryImporter::CommitBatch() {
+  std::lock_guard<std::mutex> lock(commit_mutex_);
+  if (!batch_.empty()) {
+    commit_(batch_);
+    batch_.clear();
+  }
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
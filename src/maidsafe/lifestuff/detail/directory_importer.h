@@ -0,0 +1,142 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_DIRECTORY_IMPORTER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_DIRECTORY_IMPORTER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/data_store/permanent_store.h"
+
+#include "maidsafe/lifestuff/lifestuff.h"
+#include "maidsafe/lifestuff/detail/chunk_fetcher.h"
+#include "maidsafe/lifestuff/detail/chunk_uploader.h"
+#include "maidsafe/lifestuff/detail/content_index.h"
+#include "maidsafe/lifestuff/detail/file_encryptor.h"
+#include "maidsafe/lifestuff/detail/mount_profile.h"
+#include "maidsafe/lifestuff/detail/task_group.h"
+#include "maidsafe/lifestuff/detail/upload_journal.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Copies a local directory tree into the drive without passing file contents through the mounted
+// file system.  The source tree is walked in parallel, files are self-encrypted on the worker
+// pool, their chunks handed to the uploader, and the resulting data maps committed in batches.
+// Large files are encrypted using several workers each, with their chunks uploaded while the rest
+// of the file is still being encrypted.  Their confirmed chunks are journalled in
+// 'journal_directory' until the import completes, so that repeating an interrupted import only
+// re-encrypts them and puts the remainder.  Files no larger than the profile's
+// max_inline_file_size are held in their data maps and need no puts at all.  Files whose content
+// is in 'content_index' reuse the indexed data map if its chunks are still held locally; others
+// are added to it once their chunks are confirmed stored.  Unless the profile's durability mode is
+// write-through, imports return once chunks are in the local store, leaving journals and the index
+// to be updated by whichever call to ChunkUploader::WaitForUploads confirms them.
+class DirectoryImporter {
+ public:
+  typedef data_store::PermanentStore PermanentStore;
+  typedef std::pair<boost::filesystem::path, std::string> DataMapEntry;
+  // Creates the directory at the given path, relative to the import destination.
+  typedef std::function<void(const boost::filesystem::path&)> CreateDirectoryFunctor;
+  // Adds files to the drive given their relative paths and serialised data maps.
+  typedef std::function<void(const std::vector<DataMapEntry>&)> CommitFunctor;
+
+  DirectoryImporter(PermanentStore& data_store,
+                    ChunkUploader& chunk_uploader,
+                    boost::asio::io_service& io_service,
+                    const MountProfile& profile,
+                    const boost::filesystem::path& journal_directory,
+                    ContentIndex& content_index);
+  ~DirectoryImporter() {}
+
+  // Blocks until the whole tree rooted at 'local_path' has been imported, as defined by the
+  // durability mode.  Throws the first error encountered by any worker.
+  void Import(const boost::filesystem::path& local_path,
+              const CreateDirectoryFunctor& create_directory,
+              const CommitFunctor& commit,
+              const TransferProgressFunction& progress);
+  // Imports the single file 'local_file' and returns its serialised data map once it has been
+  // imported, as defined by the durability mode.  Committing the data map is left to the caller.
+  std::string ImportFile(const boost::filesystem::path& local_file,
+                         const TransferProgressFunction& progress);
+
+ private:
+  DirectoryImporter(const DirectoryImporter&);
+  DirectoryImporter& operator=(const DirectoryImporter&);
+
+  typedef std::pair<boost::filesystem::path, uint64_t> FileEntry;
+  struct UploadedContent {
+    UploadedContent(const std::string& content_hash_in,
+                    uint64_t content_size_in,
+                    const std::string& serialised_data_map_in)
+        : content_hash(content_hash_in),
+          content_size(content_size_in),
+          serialised_data_map(serialised_data_map_in) {}
+    std::string content_hash;
+    uint64_t content_size;
+    std::string serialised_data_map;
+  };
+
+  void ListDirectory(const boost::filesystem::path& relative_path);
+  void ImportEntry(const FileEntry& file);
+  uint64_t EstimateStoredSize(const boost::filesystem::path& local_file, uint64_t size) const;
+  encrypt::DataMapPtr EncryptAndUpload(const boost::filesystem::path& local_file, uint64_t size);
+  std::shared_ptr<UploadJournal> OpenJournal(const boost::filesystem::path& local_file,
+                                             uint64_t size);
+  // Hands this import's journals and content to the uploader, to be completed and indexed once
+  // every put made by the import has been confirmed, then waits for that if write-through.
+  void FinishUploads();
+  // Calls 'progress_' with the running total.  Workers' calls are serialised.
+  void ReportProgress(uint64_t bytes);
+  void AddToBatch(const DataMapEntry& entry);
+  void CommitBatch();
+
+  PermanentStore& data_store_;
+  ChunkUploader& chunk_uploader_;
+  ContentIndex& content_index_;
+  const uint32_t kBlockSize_;
+  const int kEncryptorThreads_;
+  const uint64_t kMaxInlineFileSize_;
+  const boost::filesystem::path kJournalDirectory_;
+  const bool kWaitForUploads_;
+  TaskGroup task_group_;
+  boost::filesystem::path local_root_;
+  CommitFunctor commit_;
+  TransferProgressFunction progress_;
+  std::set<boost::filesystem::path> directories_;
+  std::vector<FileEntry> files_;
+  std::vector<DataMapEntry> batch_;
+  std::vector<std::shared_ptr<UploadJournal>> journals_;
+  std::vector<UploadedContent> uploaded_content_;
+  uint64_t total_bytes_;
+  std::atomic<uint64_t> done_bytes_;
+  std::mutex mutex_, commit_mutex_, progress_mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_DIRECTORY_IMPORTER_H_
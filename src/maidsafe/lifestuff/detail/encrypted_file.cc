@@ -0,0 +1,79 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/encrypted_file.h"
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+crypto::AES256Key DeriveKey(const Identity& secret, const std::string& purpose) {
+  std::string hash(crypto::Hash<crypto::SHA512>(secret.string() + purpose).string());
+  return crypto::AES256Key(hash.substr(0, crypto::AES256_KeySize));
+}
+
+}  // unnamed namespace
+
+bool WriteEncryptedFile(const fs::path& file_path,
+                        const Identity& secret,
+                        const std::string& purpose,
+                        const std::string& plain_text) {
+  std::string iv(RandomString(crypto::AES256_IVSize));
+  // An empty file still needs a non-empty plain text.
+  crypto::CipherText cipher_text(crypto::SymmEncrypt(
+      crypto::PlainText(plain_text.empty() ? std::string(" ") : plain_text),
+      DeriveKey(secret, purpose),
+      crypto::AES256InitialisationVector(iv)));
+  fs::path temp_path(file_path.string() + ".tmp");
+  if (!WriteFile(temp_path, iv + cipher_text.string())) {
+    LOG(kError) << "Failed to write " << purpose << " to " << temp_path;
+    return false;
+  }
+  boost::system::error_code error_code;
+  fs::rename(temp_path, file_path, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to replace " << purpose << " at " << file_path << ": "
+                << error_code.message();
+    return false;
+  }
+  return true;
+}
+
+std::string ReadEncryptedFile(const fs::path& file_path,
+                              const Identity& secret,
+                              const std::string& purpose) {
+  std::string contents(ReadFile(file_path).string());
+  if (contents.size() <= crypto::AES256_IVSize) {
+    LOG(kWarning) << file_path << " is too short to hold an encrypted " << purpose;
+    ThrowError(CommonErrors::parsing_error);
+  }
+  return crypto::SymmDecrypt(
+      crypto::CipherText(NonEmptyString(contents.substr(crypto::AES256_IVSize))),
+      DeriveKey(secret, purpose),
+      crypto::AES256InitialisationVector(contents.substr(0, crypto::AES256_IVSize))).string();
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,47 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_ENCRYPTED_FILE_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_ENCRYPTED_FILE_H_
+
+#include <string>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Local files holding a session's state, such as its indices and pins, are encrypted with a key
+// derived from the user's 'secret' and the file's 'purpose', which keeps the keys of different
+// kinds of file apart.  A fresh random IV is chosen for each write and stored ahead of the cipher
+// text.
+
+// Replaces 'file_path' via a temporary file, so that a crash never leaves it truncated.  Logs and
+// returns false if the file couldn't be written.
+bool WriteEncryptedFile(const boost::filesystem::path& file_path,
+                        const Identity& secret,
+                        const std::string& purpose,
+                        const std::string& plain_text);
+// Throws if the file is missing or can't be decrypted.
+std::string ReadEncryptedFile(const boost::filesystem::path& file_path,
+                              const Identity& secret,
+                              const std::string& purpose);
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_ENCRYPTED_FILE_H_
@@ -0,0 +1,300 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/file_encryptor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+// The encryptor keys each chunk on the pre-encryption hashes of the two before it, wrapping round
+// at the start, so the first two chunks are rewritten on flush.  The last two may be resized as
+// the file grows.  Every other chunk is final once it has a hash.
+const size_t kUnsettledLeadingChunks(2), kUnsettledTrailingChunks(2);
+
+const uint32_t kCompressionSampleSize(64 * 1024);
+const uint32_t kCompressionSampleCount(8);
+const uint16_t kCompressionSampleLevel(1);
+
+const size_t kZeroScanStride(4096);
+
+void ReportSettledChunks(const encrypt::DataMap& data_map,
+                         const ChunksEncryptedFunctor& chunks_encrypted,
+                         size_t& next_unreported) {
+  if (data_map.chunks.size() <= kUnsettledTrailingChunks)
+    return;
+  next_unreported = std::max(next_unreported, kUnsettledLeadingChunks);
+  size_t end(data_map.chunks.size() - kUnsettledTrailingChunks);
+  std::vector<encrypt::ChunkDetails> settled;
+  for (; next_unreported < end && !data_map.chunks[next_unreported].hash.empty(); ++next_unreported)
+    settled.push_back(data_map.chunks[next_unreported]);
+  if (!settled.empty())
+    chunks_encrypted(settled);
+}
+
+}  // unnamed namespace
+
+bool IsZeroFilled(const char* data, size_t size) {
+  // Words are OR'd together in a loop the compiler vectorises, checking for non-zero bytes once
+  // per stride so that data is rejected early.
+  uint64_t accumulated(0), word(0);
+  size_t position(0);
+  while (position + sizeof(word) <= size) {
+    size_t stride_end(std::min(size, position + kZeroScanStride));
+    for (; position + sizeof(word) <= stride_end; position += sizeof(word)) {
+      std::memcpy(&word, data + position, sizeof(word));
+      accumulated |= word;
+    }
+    if (accumulated != 0)
+      return false;
+  }
+  for (; position != size; ++position)
+    accumulated |= static_cast<unsigned char>(data[position]);
+  return accumulated == 0;
+}
+
+encrypt::DataMapPtr EncryptFile(const fs::path& local_path,
+                                data_store::PermanentStore& data_store,
+                                int num_procs,
+                                uint32_t block_size,
+                                const ChunksEncryptedFunctor& chunks_encrypted,
+                                std::string* content_hash) {
+  fs::ifstream input(local_path, std::ios_base::in | std::ios_base::binary);
+  if (!input.good()) {
+    LOG(kError) << "Failed to open " << local_path;
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+  encrypt::DataMapPtr data_map(new encrypt::DataMap);
+  crypto::SHA512 hash;
+  {
+    SelfEncryptor self_encryptor(data_map, data_store, num_procs);
+    std::vector<char> block(block_size);
+    uint64_t position(0);
+    size_t next_unreported(0);
+    while (input.good()) {
+      input.read(&block[0], block_size);
+      uint32_t read(static_cast<uint32_t>(input.gcount()));
+      if (read == 0)
+        break;
+      if (content_hash)
+        hash.Update(reinterpret_cast<const unsigned char*>(&block[0]), read);
+      if (!self_encryptor.Write(&block[0], read, position)) {
+        LOG(kError) << "Failed to encrypt " << local_path << " at offset " << position;
+        ThrowError(CommonErrors::unknown);
+      }
+      position += read;
+      if (chunks_encrypted)
+        ReportSettledChunks(*data_map, chunks_encrypted, next_unreported);
+    }
+    if (input.bad()) {
+      LOG(kError) << "Failed to read " << local_path;
+      ThrowError(CommonErrors::filesystem_io_error);
+    }
+    if (!self_encryptor.Flush()) {
+      LOG(kError) << "Failed to flush encryptor for " << local_path;
+      ThrowError(CommonErrors::unknown);
+    }
+  }
+  if (content_hash) {
+    content_hash->assign(crypto::SHA512::DIGESTSIZE, 0);
+    hash.Final(reinterpret_cast<unsigned char*>(&(*content_hash)[0]));
+  }
+  return data_map;
+}
+
+double EstimateStoredRatio(const fs::path& local_path, uint64_t size) {
+  fs::ifstream input(local_path, std::ios_base::in | std::ios_base::binary);
+  uint32_t sample_size(static_cast<uint32_t>(std::min(static_cast<uint64_t>(kCompressionSampleSize),
+                                                      size)));
+  if (!input.good() || sample_size == 0)
+    return 1.0;
+  uint64_t stride(kCompressionSampleCount > 1 ?
+                  (size - sample_size) / (kCompressionSampleCount - 1) : 0);
+  std::string sample(sample_size, 0);
+  uint64_t sampled(0), compressed(0);
+  for (uint32_t i(0); i != kCompressionSampleCount; ++i) {
+    input.seekg(static_cast<std::streamoff>(i * stride));
+    input.read(&sample[0], sample_size);
+    if (input.gcount() != static_cast<std::streamsize>(sample_size))
+      break;
+    sampled += sample_size;
+    compressed += crypto::Compress(crypto::UncompressedText(sample),
+                                   kCompressionSampleLevel).string().size();
+    if (stride == 0)
+      break;
+  }
+  if (sampled == 0)
+    return 1.0;
+  return std::min(1.0, static_cast<double>(compressed) / static_cast<double>(sampled));
+}
+
+encrypt::DataMapPtr InlineFile(const fs::path& local_path) {
+  encrypt::DataMapPtr data_map(new encrypt::DataMap);
+  if (!ReadFile(local_path, &data_map->content)) {
+    LOG(kError) << "Failed to read " << local_path;
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+  return data_map;
+}
+
+void DecryptFile(encrypt::DataMapPtr data_map,
+                 data_store::PermanentStore& data_store,
+                 const fs::path& local_path,
+                 uint32_t block_size) {
+  SelfEncryptor self_encryptor(data_map, data_store);
+  uint64_t file_size(self_encryptor.size());
+  {
+    fs::ofstream output(local_path, std::ios_base::out | std::ios_base::binary |
+                                    std::ios_base::trunc);
+    if (!output.good()) {
+      LOG(kError) << "Failed to create " << local_path;
+      ThrowError(CommonErrors::filesystem_io_error);
+    }
+  }
+  boost::system::error_code error_code;
+  fs::resize_file(local_path, file_size, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to preallocate " << local_path << ": " << error_code.message();
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+
+  // The resized file already reads as zeros, so zero blocks are skipped rather than written.
+  // Chunks are named by their encrypted content, so once one chunk has decrypted to zeros, every
+  // other chunk of the same name is skipped without being decrypted.
+  std::vector<std::pair<std::string, uint64_t>> segments;
+  for (auto& chunk : data_map->chunks)
+    segments.push_back(std::make_pair(chunk.hash, static_cast<uint64_t>(chunk.size)));
+  if (segments.empty())
+    segments.push_back(std::make_pair(std::string(), file_size));
+  std::set<std::string> zero_chunks;
+  fs::fstream output(local_path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+  std::vector<char> block(block_size);
+  uint64_t position(0);
+  bool skipped(false);
+  for (auto& segment : segments) {
+    uint64_t segment_end(position + segment.second);
+    if (!segment.first.empty() && zero_chunks.count(segment.first) != 0) {
+      position = segment_end;
+      skipped = true;
+      continue;
+    }
+    bool zero_filled(true);
+    while (position < segment_end) {
+      uint32_t length(static_cast<uint32_t>(std::min(static_cast<uint64_t>(block_size),
+                                                     segment_end - position)));
+      if (!self_encryptor.Read(&block[0], length, position)) {
+        LOG(kError) << "Failed to decrypt " << local_path << " at offset " << position;
+        ThrowError(CommonErrors::unknown);
+      }
+      if (IsZeroFilled(&block[0], length)) {
+        skipped = true;
+      } else {
+        zero_filled = false;
+        if (skipped) {
+          output.seekp(static_cast<std::streamoff>(position));
+          skipped = false;
+        }
+        output.write(&block[0], length);
+      }
+      position += length;
+    }
+    if (zero_filled && !segment.first.empty())
+      zero_chunks.insert(segment.first);
+  }
+  output.close();
+  if (output.fail()) {
+    LOG(kError) << "Failed to write " << local_path;
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+}
+
+encrypt::DataMapPtr EncryptContent(const std::string& content,
+                                   data_store::PermanentStore& data_store) {
+  encrypt::DataMapPtr data_map(new encrypt::DataMap);
+  {
+    SelfEncryptor self_encryptor(data_map, data_store);
+    if (!self_encryptor.Write(content.data(), static_cast<uint32_t>(content.size()), 0) ||
+        !self_encryptor.Flush()) {
+      LOG(kError) << "Failed to encrypt content of size " << content.size();
+      ThrowError(CommonErrors::unknown);
+    }
+  }
+  return data_map;
+}
+
+std::string DecryptContent(encrypt::DataMapPtr data_map, data_store::PermanentStore& data_store) {
+  SelfEncryptor self_encryptor(data_map, data_store);
+  std::string content(static_cast<size_t>(self_encryptor.size()), 0);
+  if (!content.empty() &&
+      !self_encryptor.Read(&content[0], static_cast<uint32_t>(content.size()), 0)) {
+    LOG(kError) << "Failed to decrypt content of size " << content.size();
+    ThrowError(CommonErrors::unknown);
+  }
+  return content;
+}
+
+void AppendContent(encrypt::DataMapPtr data_map,
+                   const std::string& content,
+                   data_store::PermanentStore& data_store) {
+  SelfEncryptor self_encryptor(data_map, data_store);
+  uint64_t position(self_encryptor.size());
+  if (!self_encryptor.Write(content.data(), static_cast<uint32_t>(content.size()), position) ||
+      !self_encryptor.Flush()) {
+    LOG(kError) << "Failed to append " << content.size() << " bytes at offset " << position;
+    ThrowError(CommonErrors::unknown);
+  }
+}
+
+std::vector<encrypt::ChunkDetails> ChunksReencryptedByAppend(const encrypt::DataMap& data_map) {
+  std::vector<encrypt::ChunkDetails> chunks;
+  for (size_t i(0); i != data_map.chunks.size(); ++i) {
+    if (i < kUnsettledLeadingChunks || i + kUnsettledTrailingChunks >= data_map.chunks.size())
+      chunks.push_back(data_map.chunks[i]);
+  }
+  return chunks;
+}
+
+std::string SerialiseDataMap(const encrypt::DataMap& data_map) {
+  std::string serialised_data_map;
+  encrypt::SerialiseDataMap(data_map, serialised_data_map);
+  return serialised_data_map;
+}
+
+encrypt::DataMapPtr ParseDataMap(const std::string& serialised_data_map) {
+  encrypt::DataMapPtr data_map(new encrypt::DataMap);
+  encrypt::ParseDataMap(serialised_data_map, *data_map);
+  return data_map;
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
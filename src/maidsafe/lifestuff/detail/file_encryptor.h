@@ -0,0 +1,100 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_FILE_ENCRYPTOR_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_FILE_ENCRYPTOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/data_store/permanent_store.h"
+
+#include "maidsafe/encrypt/data_map.h"
+#include "maidsafe/encrypt/self_encryptor.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+typedef encrypt::SelfEncryptor<data_store::PermanentStore> SelfEncryptor;
+
+// Default size of the blocks read from or written to local files by the functions below.
+const uint32_t kFileBlockSize(1024 * 1024);
+
+// Receives chunks which the encryptor will not modify again.  Called on the encrypting thread
+// between writes, so the chunks are present in the store for the duration of the call.
+typedef std::function<void(const std::vector<encrypt::ChunkDetails>&)> ChunksEncryptedFunctor;
+
+// Self-encrypts the local file at 'local_path', storing the resulting chunks in 'data_store', and
+// returns the file's data map.  'num_procs' is passed on to the encryptor to allow it to process
+// chunks in parallel.  If 'chunks_encrypted' is set, it is given each chunk as soon as it is
+// final, except for the first two and last two which are only settled by the final flush; these
+// appear in the returned data map alone.  If 'content_hash' is given, it is set to the SHA512
+// hash of the content encrypted, taken as the file is read.
+encrypt::DataMapPtr EncryptFile(const boost::filesystem::path& local_path,
+                                data_store::PermanentStore& data_store,
+                                int num_procs = 0,
+                                uint32_t block_size = kFileBlockSize,
+                                const ChunksEncryptedFunctor& chunks_encrypted = nullptr,
+                                std::string* content_hash = nullptr);
+
+// Estimates the proportion of the local file at 'local_path', of 'size' bytes, which will be
+// stored after the encryptor compresses its chunks.  Evenly spaced samples are compressed at the
+// fastest level, which slightly overestimates.  Already-compressed content such as media gives a
+// ratio close to 1.
+double EstimateStoredRatio(const boost::filesystem::path& local_path, uint64_t size);
+
+// Returns a data map holding the whole content of the local file at 'local_path' in place of
+// chunks, as the encryptor itself does for the smallest files.  Nothing is stored; the content is
+// kept wherever the data map is, so this suits small files only.
+encrypt::DataMapPtr InlineFile(const boost::filesystem::path& local_path);
+
+// Writes the contents described by 'data_map' to 'local_path', reading chunks from 'data_store'.
+// The destination is preallocated to the full file size before any data is written, and zero
+// ranges are left unwritten so that it stays sparse where the file system supports it.  Repeats of
+// a chunk of zeros, as fill the holes of sparse files, are not decrypted again.
+void DecryptFile(encrypt::DataMapPtr data_map,
+                 data_store::PermanentStore& data_store,
+                 const boost::filesystem::path& local_path,
+                 uint32_t block_size = kFileBlockSize);
+
+// Returns true if all 'size' bytes at 'data' are zero.
+bool IsZeroFilled(const char* data, size_t size);
+
+// As EncryptFile and DecryptFile, for content held in memory.
+encrypt::DataMapPtr EncryptContent(const std::string& content,
+                                   data_store::PermanentStore& data_store);
+std::string DecryptContent(encrypt::DataMapPtr data_map, data_store::PermanentStore& data_store);
+
+// Appends 'content' to the end of the file described by 'data_map', which is updated in place.
+// Only the chunks returned by ChunksReencryptedByAppend need to be held in 'data_store'.
+void AppendContent(encrypt::DataMapPtr data_map,
+                   const std::string& content,
+                   data_store::PermanentStore& data_store);
+// Returns the existing chunks which appending to 'data_map' rereads and re-encrypts: the two
+// leading chunks, whose keys wrap round to the end of the file, and the trailing chunks which the
+// new content extends.  All others are left untouched.
+std::vector<encrypt::ChunkDetails> ChunksReencryptedByAppend(const encrypt::DataMap& data_map);
+
+std::string SerialiseDataMap(const encrypt::DataMap& data_map);
+encrypt::DataMapPtr ParseDataMap(const std::string& serialised_data_map);
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_FILE_ENCRYPTOR_H_
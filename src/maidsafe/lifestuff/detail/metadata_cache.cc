@@ -0,0 +1,118 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/metadata_cache.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+MetadataCache::MetadataCache(std::chrono::milliseconds attribute_timeout,
+                             std::chrono::milliseconds negative_timeout,
+                             size_t capacity)
+    : kAttributeTimeout_(attribute_timeout),
+      kNegativeTimeout_(negative_timeout),
+      kCapacity_(capacity),
+      items_(),
+      hits_(0),
+      misses_(0),
+      mutex_() {}
+
+MetadataCache::Result MetadataCache::Get(const fs::path& path, DirectoryEntry* entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(items_.find(path.generic_string()));
+  if (itr == items_.end() || itr->second.expiry <= Clock::now()) {
+    if (itr != items_.end())
+      items_.erase(itr);
+    ++misses_;
+    return Result::kMiss;
+  }
+  ++hits_;
+  if (!itr->second.found)
+    return Result::kNotFound;
+  *entry = itr->second.entry;
+  return Result::kFound;
+}
+
+void MetadataCache::Put(const fs::path& path, const DirectoryEntry& entry) {
+  Item item;
+  item.found = true;
+  item.entry = entry;
+  item.expiry = Clock::now() + kAttributeTimeout_;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Insert(path.generic_string(), item);
+}
+
+void MetadataCache::PutNotFound(const fs::path& path) {
+  Item item;
+  item.expiry = Clock::now() + kNegativeTimeout_;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Insert(path.generic_string(), item);
+}
+
+void MetadataCache::Invalidate(const fs::path& path) {
+  std::string key(path.generic_string());
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (key.empty()) {
+    items_.clear();
+    return;
+  }
+  items_.erase(key);
+  std::string prefix(key + '/');
+  auto itr(items_.lower_bound(prefix));
+  while (itr != items_.end() && itr->first.compare(0, prefix.size(), prefix) == 0)
+    itr = items_.erase(itr);
+  for (fs::path ancestor(path.parent_path()); !ancestor.empty();
+       ancestor = ancestor.parent_path()) {
+    auto ancestor_itr(items_.find(ancestor.generic_string()));
+    if (ancestor_itr != items_.end() && !ancestor_itr->second.found)
+      items_.erase(ancestor_itr);
+  }
+}
+
+void MetadataCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  items_.clear();
+}
+
+uint64_t MetadataCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+uint64_t MetadataCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+void MetadataCache::Insert(const std::string& key, const Item& item) {
+  if (items_.size() >= kCapacity_ && items_.count(key) == 0) {
+    Clock::time_point now(Clock::now());
+    for (auto itr(items_.begin()); itr != items_.end();) {
+      if (itr->second.expiry <= now)
+        itr = items_.erase(itr);
+      else
+        ++itr;
+    }
+    // Everything still live; start afresh rather than track recency for every lookup.
+    if (items_.size() >= kCapacity_)
+      items_.clear();
+  }
+  items_[key] = item;
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
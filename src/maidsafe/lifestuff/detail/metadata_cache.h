@@ -0,0 +1,79 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_METADATA_CACHE_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_METADATA_CACHE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/lifestuff/lifestuff.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// A TTL-bounded cache of drive entry attributes, including entries for paths known not to exist,
+// keyed by path relative to owner_path().  Lookups for names such as ".git" or "desktop.ini" which
+// tools probe repeatedly are answered without touching the drive.
+class MetadataCache {
+ public:
+  enum class Result { kMiss, kFound, kNotFound };
+
+  MetadataCache(std::chrono::milliseconds attribute_timeout,
+                std::chrono::milliseconds negative_timeout,
+                size_t capacity);
+  ~MetadataCache() {}
+
+  Result Get(const boost::filesystem::path& path, DirectoryEntry* entry);
+  void Put(const boost::filesystem::path& path, const DirectoryEntry& entry);
+  void PutNotFound(const boost::filesystem::path& path);
+  // Drops 'path', everything below it, and any not-found entries for its ancestors, since creating
+  // 'path' creates them too.
+  void Invalidate(const boost::filesystem::path& path);
+  void Clear();
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  MetadataCache(const MetadataCache&);
+  MetadataCache& operator=(const MetadataCache&);
+
+  typedef std::chrono::steady_clock Clock;
+  struct Item {
+    Item() : found(false), entry(), expiry() {}
+    bool found;
+    DirectoryEntry entry;
+    Clock::time_point expiry;
+  };
+
+  void Insert(const std::string& key, const Item& item);
+
+  const std::chrono::milliseconds kAttributeTimeout_, kNegativeTimeout_;
+  const size_t kCapacity_;
+  std::map<std::string, Item> items_;
+  uint64_t hits_, misses_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_METADATA_CACHE_H_
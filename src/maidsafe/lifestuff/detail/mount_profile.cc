@@ -0,0 +1,82 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/mount_profile.h"
+
+#include <sstream>
+
+#include "maidsafe/lifestuff/detail/file_encryptor.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+const uint32_t kMaxUploadsInFlight(32);
+const uint32_t kMaxFetchesInFlight(32);
+const uint32_t kAttributeTimeoutMs(1000);
+const uint32_t kNegativeTimeoutMs(5000);
+const uint32_t kMaxInlineFileSize(16 * 1024);
+
+uint32_t ValueOrDefault(uint32_t value, uint32_t default_value) {
+  return value == 0 ? default_value : value;
+}
+
+const char* DurabilityModeName(DurabilityMode mode) {
+  switch (mode) {
+    case DurabilityMode::kWriteBack:
+      return "write-back";
+    case DurabilityMode::kSyncOnClose:
+      return "sync-on-close";
+    default:
+      return "write-through";
+  }
+}
+
+}  // unnamed namespace
+
+MountProfile ResolveMountProfile(const MountProfile& profile, uint32_t default_worker_count) {
+  MountProfile resolved;
+  resolved.worker_count = ValueOrDefault(profile.worker_count, default_worker_count);
+  resolved.max_read_size = ValueOrDefault(profile.max_read_size, kFileBlockSize);
+  resolved.max_write_size = ValueOrDefault(profile.max_write_size, kFileBlockSize);
+  resolved.max_uploads_in_flight = ValueOrDefault(profile.max_uploads_in_flight,
+                                                  kMaxUploadsInFlight);
+  resolved.max_fetches_in_flight = ValueOrDefault(profile.max_fetches_in_flight,
+                                                  kMaxFetchesInFlight);
+  resolved.attribute_timeout_ms = ValueOrDefault(profile.attribute_timeout_ms,
+                                                 kAttributeTimeoutMs);
+  resolved.negative_timeout_ms = ValueOrDefault(profile.negative_timeout_ms, kNegativeTimeoutMs);
+  resolved.max_inline_file_size = ValueOrDefault(profile.max_inline_file_size,
+                                                 kMaxInlineFileSize);
+  resolved.durability_mode = profile.durability_mode;
+  return resolved;
+}
+
+std::string DebugString(const MountProfile& profile) {
+  std::ostringstream stream;
+  stream << "workers " << profile.worker_count << ", read size " << profile.max_read_size
+         << ", write size " << profile.max_write_size << ", uploads in flight "
+         << profile.max_uploads_in_flight << ", fetches in flight "
+         << profile.max_fetches_in_flight << ", attribute timeout "
+         << profile.attribute_timeout_ms << " ms, negative timeout "
+         << profile.negative_timeout_ms << " ms, inline files up to "
+         << profile.max_inline_file_size << " bytes, "
+         << DurabilityModeName(profile.durability_mode);
+  return stream.str();
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,76 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_MOUNT_PROFILE_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_MOUNT_PROFILE_H_
+
+#include <cstdint>
+#include <string>
+
+namespace maidsafe {
+namespace lifestuff {
+
+// When a write made through UserStorage returns, relative to its chunks being stored on the
+// network.  In every mode the chunks are in the local store, and the unmount flush stores any
+// still outstanding.
+enum class DurabilityMode {
+  // Each write returns once all of its chunks have been stored on the network.
+  kWriteThrough,
+  // Writes and UserStorage::Sync return once chunks are in the local store; they are uploaded in
+  // the background.
+  kWriteBack,
+  // Writes return once chunks are in the local store; UserStorage::Sync returns once every chunk
+  // written so far has been stored on the network.
+  kSyncOnClose
+};
+
+// Tuning applied by UserStorage for the lifetime of a mount.  Members left at zero are replaced
+// with defaults by ResolveMountProfile.
+struct MountProfile {
+  MountProfile()
+      : worker_count(0),
+        max_read_size(0),
+        max_write_size(0),
+        max_uploads_in_flight(0),
+        max_fetches_in_flight(0),
+        attribute_timeout_ms(0),
+        negative_timeout_ms(0),
+        max_inline_file_size(0),
+        durability_mode(DurabilityMode::kWriteThrough) {}
+  // Maximum number of files a single bulk transfer processes concurrently.
+  uint32_t worker_count;
+  // Sizes of the blocks read from and written to local files during bulk transfers.
+  uint32_t max_read_size;
+  uint32_t max_write_size;
+  // Maximum number of chunk puts and gets outstanding on the network.
+  uint32_t max_uploads_in_flight;
+  uint32_t max_fetches_in_flight;
+  // How long attributes of existing and of missing entries are cached for.
+  uint32_t attribute_timeout_ms;
+  uint32_t negative_timeout_ms;
+  // Files imported up to this size are held in their data maps rather than as chunks, so that a
+  // directory of small files is stored within the directory's own listing.
+  uint32_t max_inline_file_size;
+  DurabilityMode durability_mode;
+};
+
+MountProfile ResolveMountProfile(const MountProfile& profile, uint32_t default_worker_count);
+
+std::string DebugString(const MountProfile& profile);
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_MOUNT_PROFILE_H_
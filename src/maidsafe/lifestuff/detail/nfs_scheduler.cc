@@ -0,0 +1,171 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+
+#include "maidsafe/lifestuff/detail/nfs_scheduler.h"
+
+#include <algorithm>
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+// Relative shares of the slots when every class has operations waiting.
+const double kClassWeights[] = { 8.0, 8.0, 4.0, 1.0 };
+// Operations carrying little data, such as fob gets, are charged as if they carried this much.
+const uint64_t kMinimumCost(4096);
+
+size_t ClassIndex(NfsPriority priority) {
+  return static_cast<size_t>(priority);
+}
+
+bool IsBulk(size_t class_index) {
+  return class_index >= ClassIndex(NfsPriority::kForeground);
+}
+
+}  // unnamed namespace
+
+NfsScheduler::NfsScheduler(uint32_t max_in_flight, uint32_t reserved)
+    : kMaxInFlight_(std::max(2U, max_in_flight)),
+      kReserved_(std::min(reserved, kMaxInFlight_ - 1)),
+      bulk_limit_(kMaxInFlight_ - kReserved_),
+      in_flight_(0),
+      bulk_in_flight_(0),
+      virtual_time_(0),
+      last_finish_tags_(),
+      queues_(),
+      metrics_(),
+      mutex_(),
+      condition_variable_() {
+  last_finish_tags_.fill(0);
+}
+
+NfsScheduler::Ticket NfsScheduler::Acquire(NfsPriority priority, uint64_t bytes) {
+  Ticket ticket;
+  ticket.priority = priority;
+  ticket.requested = Clock::now();
+  size_t class_index(ClassIndex(priority));
+  std::unique_lock<std::mutex> lock(mutex_);
+  Request request(Tag(class_index, bytes));
+  queues_[class_index].push_back(&request);
+  Dispatch();
+  condition_variable_.wait(lock, [&request] { return request.granted; });
+  ticket.granted = request.granted_time;
+  return ticket;
+}
+
+bool NfsScheduler::TryAcquire(NfsPriority priority, uint64_t bytes, Ticket* ticket) {
+  size_t class_index(ClassIndex(priority));
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& queue : queues_) {
+    if (!queue.empty())
+      return false;
+  }
+  if (!Admissible(class_index))
+    return false;
+  Request request(Tag(class_index, bytes));
+  Grant(class_index, request);
+  ticket->priority = priority;
+  ticket->requested = ticket->granted = request.granted_time;
+  return true;
+}
+
+void NfsScheduler::Release(const Ticket& ticket) {
+  size_t class_index(ClassIndex(ticket.priority));
+  Clock::time_point now(Clock::now());
+  std::lock_guard<std::mutex> lock(mutex_);
+  --in_flight_;
+  if (IsBulk(class_index))
+    --bulk_in_flight_;
+  Metrics& metrics(metrics_[class_index]);
+  std::chrono::microseconds wait(
+      std::chrono::duration_cast<std::chrono::microseconds>(ticket.granted - ticket.requested));
+  std::chrono::microseconds latency(
+      std::chrono::duration_cast<std::chrono::microseconds>(now - ticket.requested));
+  ++metrics.operations;
+  metrics.total_wait += wait;
+  metrics.max_wait = std::max(metrics.max_wait, wait);
+  metrics.total_latency += latency;
+  metrics.max_latency = std::max(metrics.max_latency, latency);
+  Dispatch();
+}
+
+void NfsScheduler::set_bulk_share(double share) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  share = std::max(0.0, std::min(1.0, share));
+  bulk_limit_ = std::max(1U, static_cast<uint32_t>(share * (kMaxInFlight_ - kReserved_) + 0.5));
+  Dispatch();
+}
+
+NfsScheduler::Metrics NfsScheduler::metrics(NfsPriority priority) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_[ClassIndex(priority)];
+}
+
+size_t NfsScheduler::queued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t queued(0);
+  for (auto& queue : queues_)
+    queued += queue.size();
+  return queued;
+}
+
+bool NfsScheduler::Admissible(size_t class_index) const {
+  if (in_flight_ >= kMaxInFlight_)
+    return false;
+  return !IsBulk(class_index) || bulk_in_flight_ < bulk_limit_;
+}
+
+NfsScheduler::Request NfsScheduler::Tag(size_t class_index, uint64_t bytes) {
+  // A class which has been idle starts from the current virtual time rather than from where it
+  // left off, so it can't claim a backlog of unused share.
+  double start_tag(std::max(virtual_time_, last_finish_tags_[class_index]));
+  double cost(static_cast<double>(std::max(bytes, kMinimumCost)));
+  last_finish_tags_[class_index] = start_tag + cost / kClassWeights[class_index];
+  return Request(start_tag, last_finish_tags_[class_index]);
+}
+
+void NfsScheduler::Grant(size_t class_index, Request& request) {
+  ++in_flight_;
+  if (IsBulk(class_index))
+    ++bulk_in_flight_;
+  virtual_time_ = std::max(virtual_time_, request.start_tag);
+  request.granted = true;
+  request.granted_time = Clock::now();
+}
+
+void NfsScheduler::Dispatch() {
+  bool granted(false);
+  for (;;) {
+    size_t best(kClassCount);
+    for (size_t i(0); i != kClassCount; ++i) {
+      if (queues_[i].empty() || !Admissible(i))
+        continue;
+      if (best == kClassCount || queues_[i].front()->finish_tag < queues_[best].front()->finish_tag)
+        best = i;
+    }
+    if (best == kClassCount)
+      break;
+    Grant(best, *queues_[best].front());
+    queues_[best].pop_front();
+    granted = true;
+  }
+  if (granted)
+    condition_variable_.notify_all();
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,148 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_NFS_SCHEDULER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_NFS_SCHEDULER_H_
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Classes of network operation, most urgent first.
+enum class NfsPriority {
+  // Lookups a user is directly waiting on.
+  kInteractive,
+  // Storing and retrieving credentials and sessions, as for login or a credential change.
+  kSessionCritical,
+  // Chunk transfers a caller is blocked on, such as imports, exports and appends.
+  kForeground,
+  // Chunk transfers nobody is waiting on, such as write-back uploads.
+  kBackground
+};
+
+// Decides when each network operation may be issued, so that bulk transfers on any mount cannot
+// delay session-critical operations on another.  At most 'max_in_flight' operations are
+// outstanding, of which 'reserved' are only available to the interactive and session-critical
+// classes.  Waiting operations are granted in weighted fair queueing order: each class receives
+// a share of the slots in proportion to its weight, measured in bytes, so a busy background class
+// still progresses while foreground work is queued.
+class NfsScheduler {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Issued for each granted operation and handed back to Release once it completes.
+  struct Ticket {
+    Ticket() : priority(NfsPriority::kBackground), requested(), granted() {}
+    NfsPriority priority;
+    Clock::time_point requested, granted;
+  };
+
+  // Per-class figures since construction.  Waits are from request to grant, latencies from
+  // request to release.
+  struct Metrics {
+    Metrics()
+        : operations(0),
+          total_wait(0),
+          max_wait(0),
+          total_latency(0),
+          max_latency(0) {}
+    uint64_t operations;
+    std::chrono::microseconds total_wait, max_wait, total_latency, max_latency;
+  };
+
+  NfsScheduler(uint32_t max_in_flight, uint32_t reserved);
+  ~NfsScheduler() {}
+
+  // Blocks until an operation of class 'priority' transferring about 'bytes' may be issued.
+  Ticket Acquire(NfsPriority priority, uint64_t bytes);
+  // As Acquire, but returns false rather than blocking, or queueing behind waiting operations.
+  bool TryAcquire(NfsPriority priority, uint64_t bytes, Ticket* ticket);
+  void Release(const Ticket& ticket);
+  // Limits the foreground and background classes to 'share' of their usual slots, at least one.
+  // 'share' is clamped to (0, 1].
+  void set_bulk_share(double share);
+
+  Metrics metrics(NfsPriority priority) const;
+  // Number of operations waiting to be granted.
+  size_t queued() const;
+
+ private:
+  NfsScheduler(const NfsScheduler&);
+  NfsScheduler& operator=(const NfsScheduler&);
+
+  static const size_t kClassCount = 4;
+
+  struct Request {
+    Request(double start_tag_in, double finish_tag_in)
+        : start_tag(start_tag_in),
+          finish_tag(finish_tag_in),
+          granted(false) {}
+    double start_tag, finish_tag;
+    bool granted;
+    Clock::time_point granted_time;
+  };
+
+  bool Admissible(size_t class_index) const;
+  Request Tag(size_t class_index, uint64_t bytes);
+  void Grant(size_t class_index, Request& request);
+  void Dispatch();
+
+  const uint32_t kMaxInFlight_, kReserved_;
+  uint32_t bulk_limit_, in_flight_, bulk_in_flight_;
+  double virtual_time_;
+  std::array<double, kClassCount> last_finish_tags_;
+  std::array<std::deque<Request*>, kClassCount> queues_;
+  std::array<Metrics, kClassCount> metrics_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_variable_;
+};
+
+// Holds a slot of 'scheduler' for its lifetime, or until Release is called.
+class ScopedNfsSlot {
+ public:
+  ScopedNfsSlot(NfsScheduler& scheduler, NfsPriority priority, uint64_t bytes)
+      : scheduler_(scheduler),
+        ticket_(scheduler.Acquire(priority, bytes)),
+        released_(false) {}
+  ~ScopedNfsSlot() { Release(); }
+
+  // Releases the slot early; later calls have no effect.
+  void Release() {
+    if (released_)
+      return;
+    released_ = true;
+    scheduler_.Release(ticket_);
+  }
+
+ private:
+  ScopedNfsSlot(const ScopedNfsSlot&);
+  ScopedNfsSlot& operator=(const ScopedNfsSlot&);
+
+  NfsScheduler& scheduler_;
+  NfsScheduler::Ticket ticket_;
+  bool released_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_NFS_SCHEDULER_H_
@@ -0,0 +1,163 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/offline_journal.h"
+
+#include <algorithm>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+// Each line is "C <hex chunk name> <size>" or "M <hex data map> <drive path>".
+const char kChunkTag('C');
+const char kChangeTag('M');
+
+bool ParseEntry(const std::string& line, OfflineJournal::Entry* entry) {
+  if (line.size() < 4 || line[1] != ' ')
+    return false;
+  size_t separator(line.find(' ', 2));
+  if (separator == std::string::npos || separator + 1 == line.size())
+    return false;
+  std::string hex(line.substr(2, separator - 2)), rest(line.substr(separator + 1));
+  if (line[0] == kChunkTag) {
+    entry->type = OfflineJournal::Entry::Type::kChunk;
+    entry->chunk_name = DecodeFromHex(hex);
+    entry->size = std::stoull(rest);
+    return !entry->chunk_name.empty();
+  }
+  if (line[0] == kChangeTag) {
+    entry->type = OfflineJournal::Entry::Type::kChange;
+    entry->serialised_data_map = DecodeFromHex(hex);
+    entry->drive_path = rest;
+    return true;
+  }
+  return false;
+}
+
+void WriteEntry(const OfflineJournal::Entry& entry, std::ostream& stream) {
+  if (entry.type == OfflineJournal::Entry::Type::kChunk) {
+    stream << kChunkTag << ' ' << EncodeToHex(entry.chunk_name) << ' ' << entry.size << std::endl;
+  } else {
+    stream << kChangeTag << ' ' << EncodeToHex(entry.serialised_data_map) << ' '
+           << entry.drive_path.generic_string() << std::endl;
+  }
+}
+
+}  // unnamed namespace
+
+OfflineJournal::OfflineJournal(const fs::path& journal_path)
+    : kJournalPath_(journal_path),
+      entries_(),
+      first_sequence_(0),
+      journal_(),
+      mutex_() {
+  Load();
+  boost::system::error_code error_code;
+  fs::create_directories(kJournalPath_.parent_path(), error_code);
+  bool existing(fs::file_size(kJournalPath_, error_code) != 0 && !error_code);
+  journal_.open(kJournalPath_, std::ios_base::out | std::ios_base::app);
+  if (!journal_.good())
+    LOG(kWarning) << "Failed to open " << kJournalPath_ << "; offline changes won't survive a "
+                  << "restart.";
+  // Terminate any entry left incomplete by a crash so it doesn't run into the next one.
+  if (existing)
+    journal_ << std::endl;
+  if (!entries_.empty())
+    LOG(kInfo) << "Loaded " << entries_.size() << " offline journal entries awaiting replay.";
+}
+
+void OfflineJournal::Load() {
+  fs::ifstream journal(kJournalPath_);
+  std::string line;
+  while (std::getline(journal, line)) {
+    // A line cut short by a crash fails to parse and is ignored.
+    Entry entry;
+    try {
+      if (ParseEntry(line, &entry))
+        entries_.push_back(entry);
+    }
+    catch(const std::exception&) {}
+  }
+}
+
+void OfflineJournal::RecordChunk(const std::string& chunk_name, uint64_t size) {
+  Entry entry;
+  entry.type = Entry::Type::kChunk;
+  entry.chunk_name = chunk_name;
+  entry.size = size;
+  Append(entry);
+}
+
+void OfflineJournal::RecordChange(const fs::path& drive_path,
+                                  const std::string& serialised_data_map) {
+  Entry entry;
+  entry.type = Entry::Type::kChange;
+  entry.drive_path = drive_path;
+  entry.serialised_data_map = serialised_data_map;
+  Append(entry);
+}
+
+std::vector<OfflineJournal::Entry> OfflineJournal::entries(uint64_t* sequence) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *sequence = first_sequence_ + entries_.size();
+  return entries_;
+}
+
+void OfflineJournal::Discard(uint64_t sequence) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (sequence <= first_sequence_)
+    return;
+  size_t count(static_cast<size_t>(std::min<uint64_t>(sequence - first_sequence_,
+                                                      entries_.size())));
+  entries_.erase(entries_.begin(), entries_.begin() + count);
+  first_sequence_ += count;
+  journal_.close();
+  boost::system::error_code error_code;
+  if (entries_.empty()) {
+    fs::remove(kJournalPath_, error_code);
+  } else {
+    // Rewritten beside the journal and renamed over it, so a crash leaves one version intact.
+    fs::path temp_path(kJournalPath_.string() + ".tmp");
+    {
+      fs::ofstream temp(temp_path, std::ios_base::out | std::ios_base::trunc);
+      for (auto& entry : entries_)
+        WriteEntry(entry, temp);
+    }
+    fs::rename(temp_path, kJournalPath_, error_code);
+  }
+  if (error_code)
+    LOG(kWarning) << "Failed to update " << kJournalPath_ << ": " << error_code.message();
+}
+
+void OfflineJournal::Append(const Entry& entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.push_back(entry);
+  // Closed by Discard, so that a fully replayed journal leaves no file behind.
+  if (!journal_.is_open())
+    journal_.open(kJournalPath_, std::ios_base::out | std::ios_base::app);
+  WriteEntry(entry, journal_);
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
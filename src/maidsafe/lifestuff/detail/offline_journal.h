@@ -0,0 +1,80 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_OFFLINE_JOURNAL_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_OFFLINE_JOURNAL_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Records, in order, what was written to the drive while the network was unavailable: the chunks
+// held in the local store awaiting a put, and the data maps inserted into the drive.  Entries are
+// appended and flushed as they are made, so that they are replayed when the network returns even
+// if the session is closed first.
+class OfflineJournal {
+ public:
+  struct Entry {
+    enum class Type { kChunk, kChange };
+    Entry() : type(Type::kChunk), chunk_name(), size(0), drive_path(), serialised_data_map() {}
+    Type type;
+    // Set for kChunk entries.
+    std::string chunk_name;
+    uint64_t size;
+    // Set for kChange entries; 'drive_path' is relative to the owner directory.
+    boost::filesystem::path drive_path;
+    std::string serialised_data_map;
+  };
+
+  // Loads any entries left in 'journal_path' by an earlier session.
+  explicit OfflineJournal(const boost::filesystem::path& journal_path);
+  ~OfflineJournal() {}
+
+  // Both are safe to call concurrently.
+  void RecordChunk(const std::string& chunk_name, uint64_t size);
+  void RecordChange(const boost::filesystem::path& drive_path,
+                    const std::string& serialised_data_map);
+  // Returns the entries not yet discarded, setting 'sequence' to pass to Discard once they have
+  // been replayed.
+  std::vector<Entry> entries(uint64_t* sequence) const;
+  // Removes the entries returned with 'sequence' and any earlier ones, but none recorded since.
+  void Discard(uint64_t sequence);
+
+ private:
+  OfflineJournal(const OfflineJournal&);
+  OfflineJournal& operator=(const OfflineJournal&);
+
+  void Load();
+  void Append(const Entry& entry);
+
+  const boost::filesystem::path kJournalPath_;
+  std::vector<Entry> entries_;
+  // The sequence of entries_.front(); each entry's is one more than its predecessor's.
+  uint64_t first_sequence_;
+  boost::filesystem::ofstream journal_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_OFFLINE_JOURNAL_H_
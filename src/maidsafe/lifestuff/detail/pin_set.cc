@@ -0,0 +1,182 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/pin_set.h"
+
+#include <utility>
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/lifestuff/detail/data_atlas.pb.h"
+#include "maidsafe/lifestuff/detail/encrypted_file.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+// True if 'path' is 'ancestor' or lies below it.  The empty path is the root of the owner tree.
+bool IsWithin(const fs::path& path, const fs::path& ancestor) {
+  auto path_itr(path.begin());
+  for (auto& element : ancestor) {
+    if (path_itr == path.end() || *path_itr != element)
+      return false;
+    ++path_itr;
+  }
+  return true;
+}
+
+}  // unnamed namespace
+
+PinSet::PinSet() : pins_(), files_(), chunks_(), pinned_bytes_(0), mutex_() {}
+
+bool PinSet::Load(const fs::path& pins_path, const Identity& secret) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pins_.clear();
+    files_.clear();
+    chunks_.clear();
+    pinned_bytes_ = 0;
+  }
+  std::set<fs::path> pins;
+  try {
+    PinSetData pin_set_data;
+    if (!pin_set_data.ParseFromString(ReadEncryptedFile(pins_path, secret, "pins"))) {
+      LOG(kWarning) << "Failed to parse pins at " << pins_path;
+      return false;
+    }
+    for (int i(0); i != pin_set_data.paths_size(); ++i)
+      pins.insert(fs::path(pin_set_data.paths(i)));
+  }
+  catch(const std::exception& e) {
+    LOG(kInfo) << "No usable pins at " << pins_path << ": " << e.what();
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  pins_.swap(pins);
+  return true;
+}
+
+void PinSet::Save(const fs::path& pins_path, const Identity& secret) const {
+  PinSetData pin_set_data;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& pin : pins_)
+      pin_set_data.add_paths(pin.generic_string());
+  }
+  WriteEncryptedFile(pins_path, secret, "pins", pin_set_data.SerializeAsString());
+}
+
+bool PinSet::Pin(const fs::path& drive_path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pins_.insert(drive_path).second;
+}
+
+bool PinSet::Unpin(const fs::path& drive_path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pins_.erase(drive_path) == 0)
+    return false;
+  RemoveFilesUnder(drive_path, [this](const fs::path& file_path) {
+                                 return !IsPinnedLocked(file_path);
+                               });
+  return true;
+}
+
+bool PinSet::IsPinned(const fs::path& drive_path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return IsPinnedLocked(drive_path);
+}
+
+std::vector<fs::path> PinSet::pins() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::vector<fs::path>(pins_.begin(), pins_.end());
+}
+
+void PinSet::SetChunks(const fs::path& drive_path,
+                       const std::map<fs::path, ChunkSizes>& files) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!IsPinnedLocked(drive_path))
+    return;
+  RemoveFilesUnder(drive_path, [](const fs::path&) { return true; });
+  for (auto& file : files)
+    AddFile(file.first, file.second);
+}
+
+void PinSet::SetFileChunks(const fs::path& file_path, const ChunkSizes& chunks) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!IsPinnedLocked(file_path))
+    return;
+  auto file(files_.find(file_path));
+  if (file != files_.end())
+    RemoveFile(file);
+  AddFile(file_path, chunks);
+}
+
+bool PinSet::ContainsChunk(const std::string& chunk_name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return chunks_.count(chunk_name) != 0;
+}
+
+uint64_t PinSet::pinned_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pinned_bytes_;
+}
+
+bool PinSet::IsPinnedLocked(const fs::path& drive_path) const {
+  for (fs::path path(drive_path); ; path = path.parent_path()) {
+    if (pins_.count(path) != 0)
+      return true;
+    if (path.empty())
+      return false;
+  }
+}
+
+void PinSet::AddFile(const fs::path& file_path, const ChunkSizes& chunks) {
+  files_[file_path] = chunks;
+  for (auto& chunk : chunks) {
+    auto inserted(chunks_.insert(std::make_pair(chunk.first, std::make_pair(chunk.second, 0))));
+    if (inserted.second)
+      pinned_bytes_ += chunk.second;
+    ++inserted.first->second.second;
+  }
+}
+
+void PinSet::RemoveFile(std::map<fs::path, ChunkSizes>::iterator file) {
+  for (auto& chunk : file->second) {
+    auto tracked(chunks_.find(chunk.first));
+    if (tracked != chunks_.end() && --tracked->second.second == 0) {
+      pinned_bytes_ -= tracked->second.first;
+      chunks_.erase(tracked);
+    }
+  }
+  files_.erase(file);
+}
+
+template<typename Predicate>
+void PinSet::RemoveFilesUnder(const fs::path& drive_path, Predicate remove) {
+  // Paths order element by element, so everything under 'drive_path' is contiguous.
+  auto file(files_.lower_bound(drive_path));
+  while (file != files_.end() && IsWithin(file->first, drive_path)) {
+    if (remove(file->first))
+      RemoveFile(file++);
+    else
+      ++file;
+  }
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
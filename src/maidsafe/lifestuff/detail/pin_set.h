@@ -0,0 +1,91 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_PIN_SET_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_PIN_SET_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// The drive paths, relative to owner_path(), whose content is kept in the local store so that it
+// can be read without the network.  A pinned directory covers everything below it.  Alongside the
+// pins, the chunks referenced by each covered file are tracked, so that they can be protected
+// from removal and their total size reported.  Only the pins are saved, to an encrypted file; the
+// chunks are tracked afresh by refreshing each pin after mounting.
+class PinSet {
+ public:
+  // Chunk names and their sizes before compression.
+  typedef std::map<std::string, uint64_t> ChunkSizes;
+
+  PinSet();
+  ~PinSet() {}
+
+  // Replaces the pins with those saved at 'pins_path'.  Returns false, leaving the set empty, if
+  // there are no saved pins or they can't be decrypted with 'secret'.
+  bool Load(const boost::filesystem::path& pins_path, const Identity& secret);
+  void Save(const boost::filesystem::path& pins_path, const Identity& secret) const;
+
+  // Each returns false if there was nothing to change.  Unpinning stops tracking the files the
+  // pin covered, other than those still covered by another pin.
+  bool Pin(const boost::filesystem::path& drive_path);
+  bool Unpin(const boost::filesystem::path& drive_path);
+  // True if 'drive_path' or one of its ancestors is pinned.
+  bool IsPinned(const boost::filesystem::path& drive_path) const;
+  std::vector<boost::filesystem::path> pins() const;
+
+  // Records the chunks of every file currently under the pinned 'drive_path', which may be a file
+  // or a directory, replacing whatever was tracked below it.
+  void SetChunks(const boost::filesystem::path& drive_path,
+                 const std::map<boost::filesystem::path, ChunkSizes>& files);
+  // As above for a single file, leaving other files untouched.  Ignored unless the file is pinned.
+  void SetFileChunks(const boost::filesystem::path& file_path, const ChunkSizes& chunks);
+  bool ContainsChunk(const std::string& chunk_name) const;
+  // Total size of the distinct chunks referenced by pinned files.
+  uint64_t pinned_bytes() const;
+
+ private:
+  PinSet(const PinSet&);
+  PinSet& operator=(const PinSet&);
+
+  bool IsPinnedLocked(const boost::filesystem::path& drive_path) const;
+  void AddFile(const boost::filesystem::path& file_path, const ChunkSizes& chunks);
+  void RemoveFile(std::map<boost::filesystem::path, ChunkSizes>::iterator file);
+  // Stops tracking files under 'drive_path' for which 'remove' returns true.
+  template<typename Predicate>
+  void RemoveFilesUnder(const boost::filesystem::path& drive_path, Predicate remove);
+
+  std::set<boost::filesystem::path> pins_;
+  std::map<boost::filesystem::path, ChunkSizes> files_;
+  // Each chunk's size and the number of tracked files referencing it.
+  std::map<std::string, std::pair<uint64_t, size_t>> chunks_;
+  uint64_t pinned_bytes_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_PIN_SET_H_
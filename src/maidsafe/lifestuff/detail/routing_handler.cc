@@ -18,19 +18,19 @@ License.
 namespace maidsafe {
 namespace lifestuff {
 
-RoutingHandler::RoutingHandler(const Maid& maid, PublicKeyRequestFunction public_key_request)
+RoutingHandler::RoutingHandler(const Maid& maid,
+                               PublicKeyRequestFunction public_key_request,
+                               NetworkHealthFunction network_health)
   : routing_(maid),
     public_key_request_(public_key_request),
+    network_health_function_(network_health),
     network_health_(),
     mutex_(),
     condition_variable_(),
-    asio_service_(2) {
-  asio_service_.Start();
-}
+    shared_resources_(SharedResources::Get()),
+    task_group_(shared_resources_->routing_io_service()) {}
 
-RoutingHandler::~RoutingHandler() {
-  asio_service_.Stop();
-}
+RoutingHandler::~RoutingHandler() {}
 
 void RoutingHandler::Join(const EndPointVector& bootstrap_endpoints) {
   routing_.Join(InitialiseFunctors(), UdpEndpoints(bootstrap_endpoints));
@@ -63,7 +63,7 @@ RoutingHandler::Functors RoutingHandler::InitialiseFunctors() {
 
 void RoutingHandler::OnMessageReceived(const std::string& message,
                                        const ReplyFunctor& reply_functor) {
-  asio_service_.service().post([=] { DoOnMessageReceived(message, reply_functor); });
+  Post([=] { DoOnMessageReceived(message, reply_functor); });
 }
 
 void RoutingHandler::DoOnMessageReceived(const std::string& /*message*/,
@@ -71,7 +71,7 @@ void RoutingHandler::DoOnMessageReceived(const std::string& /*message*/,
 }
 
 void RoutingHandler::OnNetworkStatusChange(const int& network_health) {
-  asio_service_.service().post([=] { DoOnNetworkStatusChange(network_health); });
+  Post([=] { DoOnNetworkStatusChange(network_health); });
 }
 
 void RoutingHandler::DoOnNetworkStatusChange(const int& network_health) {
@@ -89,11 +89,14 @@ void RoutingHandler::DoOnNetworkStatusChange(const int& network_health) {
                   << " - Network is down (" << network_health << ")";
   }
   network_health_ = network_health;
+  shared_resources_->AdaptToNetworkHealth(network_health);
+  if (network_health_function_)
+    network_health_function_(network_health);
 }
 
 void RoutingHandler::OnPublicKeyRequested(const NodeId& node_id,
                                           const GivePublicKeyFunctor& give_key) {
-  asio_service_.service().post([=] { DoOnPublicKeyRequested(node_id, give_key); });
+  Post([=] { DoOnPublicKeyRequested(node_id, give_key); });
 }
 
 void RoutingHandler::DoOnPublicKeyRequested(const NodeId& node_id,
@@ -102,12 +105,23 @@ void RoutingHandler::DoOnPublicKeyRequested(const NodeId& node_id,
 }
 
 void RoutingHandler::OnNewBootstrapEndpoint(const UdpEndPoint& endpoint) {
-  asio_service_.service().post([=] { DoOnNewBootstrapEndpoint(endpoint); });
+  Post([=] { DoOnNewBootstrapEndpoint(endpoint); });
 }
 
 void RoutingHandler::DoOnNewBootstrapEndpoint(const UdpEndPoint& /*endpoint*/) {
 }
 
+void RoutingHandler::Post(const std::function<void()>& task) {
+  task_group_.Post([task] {
+                     try {
+                       task();
+                     }
+                     catch(const std::exception& e) {
+                       LOG(kError) << "Routing callback failed: " << e.what();
+                     }
+                   });
+}
+
 RoutingHandler::UdpEndPointVector RoutingHandler::UdpEndpoints(const EndPointVector& endpoints) {
   std::vector<UdpEndPoint> udp_endpoints;
   for (auto& endpoint : endpoints) {
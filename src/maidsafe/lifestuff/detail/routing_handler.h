@@ -17,12 +17,17 @@ License.
 #define MAIDSAFE_LIFESTUFF_DETAIL_ROUTING_HANDLER_H_
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <mutex>
 #include <condition_variable>
 
 #include "maidsafe/routing/routing_api.h"
 
+#include "maidsafe/lifestuff/lifestuff.h"
+#include "maidsafe/lifestuff/detail/shared_resources.h"
+#include "maidsafe/lifestuff/detail/task_group.h"
+
 namespace maidsafe {
 namespace lifestuff {
  
@@ -40,7 +45,11 @@ class RoutingHandler {
   typedef std::vector<UdpEndPoint> UdpEndPointVector;
   typedef passport::Maid Maid;
 
-  RoutingHandler(const Maid& maid, PublicKeyRequestFunction public_key_request);
+  // 'network_health' is called with each change in network health, after shared resources have
+  // adapted to it.
+  RoutingHandler(const Maid& maid,
+                 PublicKeyRequestFunction public_key_request,
+                 NetworkHealthFunction network_health);
   ~RoutingHandler();
 
   void Join(const EndPointVector& endpoints);
@@ -52,6 +61,8 @@ class RoutingHandler {
   RoutingHandler& operator=(const RoutingHandler&);
 
   Functors InitialiseFunctors();
+  // Runs 'task' on the process-wide routing executor.  Errors are logged rather than propagated.
+  void Post(const std::function<void()>& task);
   
   void OnMessageReceived(const std::string& message,  const ReplyFunctor& reply_functor);
   void DoOnMessageReceived(const std::string& message, const ReplyFunctor& reply_functor);
@@ -66,10 +77,12 @@ class RoutingHandler {
 
   Routing routing_;
   PublicKeyRequestFunction public_key_request_;
+  NetworkHealthFunction network_health_function_;
   int network_health_;
   std::mutex mutex_;
   std::condition_variable condition_variable_;
-  AsioService asio_service_;
+  std::shared_ptr<SharedResources> shared_resources_;
+  TaskGroup task_group_;
 };
 
 }  // namespace lifestuff
@@ -33,6 +33,7 @@ Session::Session()
     : passport_(),
       bootstrap_endpoints_(),
       user_details_(),
+      snapshots_(),
       initialised_(false),
       keyword_(),
       pin_(),
@@ -145,6 +146,18 @@ std::vector<std::pair<std::string, uint16_t> > Session::bootstrap_endpoints() co
   return bootstrap_endpoints_;
 }
 
+Session::SnapshotMap Session::snapshots() const {
+  return snapshots_;
+}
+
+void Session::AddSnapshot(const std::string& name, const SnapshotDetails& snapshot) {
+  snapshots_[name] = snapshot;
+}
+
+void Session::RemoveSnapshot(const std::string& name) {
+  snapshots_.erase(name);
+}
+
 void Session::Parse(const NonEmptyString& serialised_data_atlas) {
   DataAtlas data_atlas;
   data_atlas.ParseFromString(serialised_data_atlas.string());
@@ -160,6 +173,13 @@ void Session::Parse(const NonEmptyString& serialised_data_atlas) {
   set_max_space(data_atlas.user_data().max_space());
   set_used_space(data_atlas.user_data().used_space());
 
+  snapshots_.clear();
+  for (int i(0); i != data_atlas.snapshots_size(); ++i) {
+    const Snapshot& snapshot(data_atlas.snapshots(i));
+    snapshots_[snapshot.name()] = SnapshotDetails(snapshot.timestamp(),
+                                                  snapshot.manifest_data_map());
+  }
+
   passport_.Parse(NonEmptyString(data_atlas.passport_data().serialised_keyring()));
 
   return;
@@ -175,6 +195,13 @@ NonEmptyString Session::Serialise() {
   user_data->set_max_space(max_space());
   user_data->set_used_space(used_space());
 
+  for (auto& entry : snapshots_) {
+    Snapshot* snapshot(data_atlas.add_snapshots());
+    snapshot->set_name(entry.first);
+    snapshot->set_timestamp(entry.second.timestamp);
+    snapshot->set_manifest_data_map(entry.second.manifest_data_map);
+  }
+
   data_atlas.set_timestamp(boost::lexical_cast<std::string>(
       GetDurationSinceEpoch().total_microseconds()));
 
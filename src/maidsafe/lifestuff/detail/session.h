@@ -43,6 +43,17 @@ class Session {
  public:
   typedef passport::Passport Passport;
   typedef std::pair<std::string, uint16_t> Endpoint;
+  // A point-in-time record of the owner tree taken by UserStorage::TakeSnapshot.  The manifest
+  // listing the tree is itself self-encrypted; only its data map is held here.
+  struct SnapshotDetails {
+    SnapshotDetails() : timestamp(0), manifest_data_map() {}
+    SnapshotDetails(int64_t timestamp_in, const std::string& manifest_data_map_in)
+        : timestamp(timestamp_in),
+          manifest_data_map(manifest_data_map_in) {}
+    int64_t timestamp;
+    std::string manifest_data_map;
+  };
+  typedef std::map<std::string, SnapshotDetails> SnapshotMap;
 
   Session();
   ~Session();
@@ -75,6 +86,10 @@ class Session {
   void set_bootstrap_endpoints(const std::vector<Endpoint>& bootstrap_endpoints);
   std::vector<Endpoint> bootstrap_endpoints() const;
 
+  SnapshotMap snapshots() const;
+  void AddSnapshot(const std::string& name, const SnapshotDetails& snapshot);
+  void RemoveSnapshot(const std::string& name);
+
   void Parse(const NonEmptyString& serialised_session);
   NonEmptyString Serialise();
 
@@ -103,6 +118,7 @@ class Session {
   Passport passport_;
   std::vector<Endpoint> bootstrap_endpoints_;
   UserDetails user_details_;
+  SnapshotMap snapshots_;
   bool initialised_;
   std::unique_ptr<Keyword> keyword_;
   std::unique_ptr<Pin> pin_;
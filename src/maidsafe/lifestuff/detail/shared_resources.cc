@@ -0,0 +1,120 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/shared_resources.h"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+// Enough for a couple of mounts' transfers at their default windows, with slots kept free for
+// logins and credential changes.
+const uint32_t kMaxNfsOperationsInFlight(64);
+const uint32_t kReservedNfsOperations(8);
+// Enough for public key requests, which wait on a network get, not to hold up other callbacks.
+const uint32_t kRoutingWorkerCount(4);
+// Maintenance is never urgent, so a couple of threads are shared by every session's.
+const uint32_t kBackgroundWorkerCount(2);
+const uint64_t kMinimumBurstBytes(1024 * 1024);
+// Network health, as a percentage, at and above which bulk transfers are not slowed.
+const int kHealthyNetwork(80);
+
+uint64_t BurstBytes(uint64_t bytes_per_second) {
+  return std::max(bytes_per_second, kMinimumBurstBytes);
+}
+
+}  // unnamed namespace
+
+std::shared_ptr<SharedResources> SharedResources::Get() {
+  static std::mutex mutex;
+  static std::weak_ptr<SharedResources> instance;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<SharedResources> resources(instance.lock());
+  if (!resources) {
+    resources.reset(new SharedResources);
+    instance = resources;
+  }
+  return resources;
+}
+
+SharedResources::SharedResources()
+    : kWorkerCount_(std::max(2U, std::thread::hardware_concurrency())),
+      asio_service_(kWorkerCount_),
+      routing_asio_service_(kRoutingWorkerCount),
+      background_asio_service_(kBackgroundWorkerCount),
+      nfs_scheduler_(kMaxNfsOperationsInFlight, kReservedNfsOperations),
+      upload_bucket_(),
+      download_bucket_() {
+  asio_service_.Start();
+  routing_asio_service_.Start();
+  background_asio_service_.Start();
+}
+
+SharedResources::~SharedResources() {
+  background_asio_service_.Stop();
+  routing_asio_service_.Stop();
+  asio_service_.Stop();
+}
+
+boost::asio::io_service& SharedResources::io_service() {
+  return asio_service_.service();
+}
+
+uint32_t SharedResources::worker_count() const {
+  return kWorkerCount_;
+}
+
+boost::asio::io_service& SharedResources::routing_io_service() {
+  return routing_asio_service_.service();
+}
+
+boost::asio::io_service& SharedResources::background_io_service() {
+  return background_asio_service_.service();
+}
+
+NfsScheduler& SharedResources::nfs_scheduler() {
+  return nfs_scheduler_;
+}
+
+TokenBucket& SharedResources::upload_bucket() {
+  return upload_bucket_;
+}
+
+TokenBucket& SharedResources::download_bucket() {
+  return download_bucket_;
+}
+
+void SharedResources::SetBandwidthLimits(uint64_t upload_bytes_per_second,
+                                         uint64_t download_bytes_per_second) {
+  upload_bucket_.SetLimit(upload_bytes_per_second, BurstBytes(upload_bytes_per_second));
+  download_bucket_.SetLimit(download_bytes_per_second, BurstBytes(download_bytes_per_second));
+}
+
+void SharedResources::AdaptToNetworkHealth(int network_health) {
+  double share(network_health >= kHealthyNetwork ? 1.0 :
+               static_cast<double>(std::max(network_health, 0)) / kHealthyNetwork);
+  share = std::max(share, TokenBucket::kMinimumBulkShare);
+  upload_bucket_.set_bulk_share(share);
+  download_bucket_.set_bulk_share(share);
+  nfs_scheduler_.set_bulk_share(share);
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,77 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_SHARED_RESOURCES_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_SHARED_RESOURCES_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/asio_service.h"
+
+#include "maidsafe/lifestuff/detail/nfs_scheduler.h"
+#include "maidsafe/lifestuff/detail/token_bucket.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Resources shared by every LifeStuff instance in the process, so that hosting many sessions does
+// not multiply thread pools.  Created on the first call to Get() and destroyed when the last
+// holder releases it.  Work posted by each session should go through a TaskGroup bounded to
+// worker_count() tasks, which keeps one session's bulk transfer from starving the others.  Network
+// operations of every session likewise go through nfs_scheduler(), and chunk transfers are shaped
+// by upload_bucket() and download_bucket(), since sessions share the same link.  Routing callbacks
+// run on routing_io_service(), whose threads are never taken by bulk work, since callbacks may
+// block on network replies.  Long-running maintenance, such as index reconciliation, replaying
+// offline changes, refreshing pins and scrubbing, runs on background_io_service() so that it
+// never holds up transfers someone is waiting for.
+class SharedResources {
+ public:
+  static std::shared_ptr<SharedResources> Get();
+  ~SharedResources();
+
+  boost::asio::io_service& io_service();
+  uint32_t worker_count() const;
+  boost::asio::io_service& routing_io_service();
+  boost::asio::io_service& background_io_service();
+  NfsScheduler& nfs_scheduler();
+  TokenBucket& upload_bucket();
+  TokenBucket& download_bucket();
+
+  // Limits chunk transfers in each direction, in bytes per second; zero removes the limit.  The
+  // buckets allow a second's worth of burst, and at least a whole chunk.
+  void SetBandwidthLimits(uint64_t upload_bytes_per_second, uint64_t download_bytes_per_second);
+  // Reduces bulk transfer rates and concurrency as 'network_health', as reported by routing,
+  // falls below a healthy level, and restores them as it recovers.  Negative values mean the
+  // network is down.
+  void AdaptToNetworkHealth(int network_health);
+
+ private:
+  SharedResources();
+  SharedResources(const SharedResources&);
+  SharedResources& operator=(const SharedResources&);
+
+  const uint32_t kWorkerCount_;
+  AsioService asio_service_, routing_asio_service_, background_asio_service_;
+  NfsScheduler nfs_scheduler_;
+  TokenBucket upload_bucket_, download_bucket_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_SHARED_RESOURCES_H_
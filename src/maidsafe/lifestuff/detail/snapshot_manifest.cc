@@ -0,0 +1,56 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/snapshot_manifest.h"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/lifestuff/detail/data_atlas.pb.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+std::string SerialiseSnapshotManifest(const std::vector<SnapshotEntry>& entries) {
+  SnapshotManifest manifest;
+  for (auto& entry : entries) {
+    SnapshotManifest::Entry* manifest_entry(manifest.add_entries());
+    manifest_entry->set_path(entry.path.generic_string());
+    manifest_entry->set_directory(entry.directory);
+    if (!entry.directory)
+      manifest_entry->set_serialised_data_map(entry.serialised_data_map);
+  }
+  return manifest.SerializeAsString();
+}
+
+std::vector<SnapshotEntry> ParseSnapshotManifest(const std::string& serialised_manifest) {
+  SnapshotManifest manifest;
+  if (!manifest.ParseFromString(serialised_manifest)) {
+    LOG(kError) << "Failed to parse snapshot manifest.";
+    ThrowError(CommonErrors::parsing_error);
+  }
+  std::vector<SnapshotEntry> entries;
+  entries.reserve(manifest.entries_size());
+  for (int i(0); i != manifest.entries_size(); ++i) {
+    const SnapshotManifest::Entry& entry(manifest.entries(i));
+    entries.push_back(SnapshotEntry(boost::filesystem::path(entry.path()).make_preferred(),
+                                    entry.directory(),
+                                    entry.serialised_data_map()));
+  }
+  return entries;
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
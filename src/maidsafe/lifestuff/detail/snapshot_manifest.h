@@ -0,0 +1,49 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_SNAPSHOT_MANIFEST_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_SNAPSHOT_MANIFEST_H_
+
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// One directory or file in a snapshot, with its path relative to the snapshot root.  Files hold
+// their serialised data map, which is empty for files with no content.
+struct SnapshotEntry {
+  SnapshotEntry() : path(), directory(false), serialised_data_map() {}
+  SnapshotEntry(const boost::filesystem::path& path_in,
+                bool directory_in,
+                const std::string& serialised_data_map_in)
+      : path(path_in),
+        directory(directory_in),
+        serialised_data_map(serialised_data_map_in) {}
+  boost::filesystem::path path;
+  bool directory;
+  std::string serialised_data_map;
+};
+
+// Entries are kept in the order given, which for a tree walk puts parents before their children.
+std::string SerialiseSnapshotManifest(const std::vector<SnapshotEntry>& entries);
+std::vector<SnapshotEntry> ParseSnapshotManifest(const std::string& serialised_manifest);
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_SNAPSHOT_MANIFEST_H_
@@ -0,0 +1,52 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/space_accountant.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+SpaceAccountant::SpaceAccountant(int64_t max_space, int64_t used_space)
+    : kMaxSpace_(max_space),
+      used_space_(used_space) {}
+
+bool SpaceAccountant::Reserve(int64_t bytes) {
+  int64_t used(used_space_.load());
+  do {
+    if (used + bytes > kMaxSpace_)
+      return false;
+  } while (!used_space_.compare_exchange_weak(used, used + bytes));
+  return true;
+}
+
+void SpaceAccountant::Release(int64_t bytes) {
+  used_space_ -= bytes;
+}
+
+int64_t SpaceAccountant::max_space() const {
+  return kMaxSpace_;
+}
+
+int64_t SpaceAccountant::used_space() const {
+  return used_space_;
+}
+
+int64_t SpaceAccountant::available_space() const {
+  int64_t available(kMaxSpace_ - used_space_);
+  return available > 0 ? available : 0;
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
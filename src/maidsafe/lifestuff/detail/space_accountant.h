@@ -0,0 +1,52 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_SPACE_ACCOUNTANT_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_SPACE_ACCOUNTANT_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Tracks space used against the account's limit while the drive is mounted.  All updates are
+// lock-free, so chunks can be charged from any thread as they are stored.
+class SpaceAccountant {
+ public:
+  SpaceAccountant(int64_t max_space, int64_t used_space);
+  ~SpaceAccountant() {}
+
+  // Charges 'bytes' if that keeps usage within the limit, otherwise charges nothing and returns
+  // false.
+  bool Reserve(int64_t bytes);
+  void Release(int64_t bytes);
+
+  int64_t max_space() const;
+  int64_t used_space() const;
+  int64_t available_space() const;
+
+ private:
+  SpaceAccountant(const SpaceAccountant&);
+  SpaceAccountant& operator=(const SpaceAccountant&);
+
+  const int64_t kMaxSpace_;
+  std::atomic<int64_t> used_space_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_SPACE_ACCOUNTANT_H_
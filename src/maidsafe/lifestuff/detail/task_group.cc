@@ -0,0 +1,90 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/task_group.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+TaskGroup::TaskGroup(boost::asio::io_service& io_service, uint32_t max_posted)
+    : io_service_(io_service),
+      kMaxPosted_(max_posted == 0 ? 1 : max_posted),
+      outstanding_tasks_(0),
+      posted_tasks_(0),
+      queued_tasks_(),
+      error_(),
+      mutex_(),
+      condition_variable_() {}
+
+TaskGroup::~TaskGroup() {
+  // Tasks capture 'this', so none may outlive the group.
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_variable_.wait(lock, [this] { return outstanding_tasks_ == 0; });
+}
+
+void TaskGroup::Post(const std::function<void()>& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++outstanding_tasks_;
+    if (posted_tasks_ == kMaxPosted_) {
+      queued_tasks_.push_back(task);
+      return;
+    }
+    ++posted_tasks_;
+  }
+  io_service_.post([this, task] { Run(task); });
+}
+
+void TaskGroup::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_variable_.wait(lock, [this] { return outstanding_tasks_ == 0; });
+  if (error_) {
+    std::exception_ptr error(error_);
+    error_ = std::exception_ptr();
+    std::rethrow_exception(error);
+  }
+}
+
+void TaskGroup::Run(const std::function<void()>& task) {
+  bool abandoned(false);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    abandoned = static_cast<bool>(error_);
+  }
+  if (!abandoned) {
+    try {
+      task();
+    }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_)
+        error_ = std::current_exception();
+    }
+  }
+  // Notify while holding the lock; a waiter may destroy the group as soon as it is released.
+  std::lock_guard<std::mutex> lock(mutex_);
+  --outstanding_tasks_;
+  if (queued_tasks_.empty()) {
+    --posted_tasks_;
+  } else {
+    std::function<void()> next(queued_tasks_.front());
+    queued_tasks_.pop_front();
+    io_service_.post([this, next] { Run(next); });
+  }
+  condition_variable_.notify_all();
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,63 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_TASK_GROUP_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_TASK_GROUP_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+
+#include "boost/asio/io_service.hpp"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Tracks a set of tasks posted to a shared io_service so that the poster can wait for just those
+// tasks.  After the first task throws, tasks which have not yet started are skipped and Wait
+// rethrows that exception.  At most 'max_posted' tasks are queued on the io_service at once; the
+// rest wait in the group, so that tasks from groups sharing an io_service are interleaved.
+class TaskGroup {
+ public:
+  explicit TaskGroup(boost::asio::io_service& io_service,
+                     uint32_t max_posted = std::numeric_limits<uint32_t>::max());
+  ~TaskGroup();
+
+  void Post(const std::function<void()>& task);
+  void Wait();
+
+ private:
+  TaskGroup(const TaskGroup&);
+  TaskGroup& operator=(const TaskGroup&);
+
+  void Run(const std::function<void()>& task);
+
+  boost::asio::io_service& io_service_;
+  const uint32_t kMaxPosted_;
+  uint32_t outstanding_tasks_, posted_tasks_;
+  std::deque<std::function<void()>> queued_tasks_;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_TASK_GROUP_H_
@@ -0,0 +1,101 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+
+#include "maidsafe/lifestuff/detail/token_bucket.h"
+
+#include <algorithm>
+
+namespace maidsafe {
+namespace lifestuff {
+
+const double TokenBucket::kMinimumBulkShare(0.05);
+
+TokenBucket::TokenBucket()
+    : bytes_per_second_(0),
+      burst_bytes_(0),
+      bulk_share_(1.0),
+      tokens_(0),
+      last_refill_(Clock::now()),
+      mutex_(),
+      condition_variable_() {}
+
+void TokenBucket::SetLimit(uint64_t bytes_per_second, uint64_t burst_bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Refill(Clock::now());
+    // A newly limited bucket starts full.
+    bool was_unlimited(bytes_per_second_ == 0);
+    bytes_per_second_ = bytes_per_second;
+    burst_bytes_ = std::max(burst_bytes, static_cast<uint64_t>(1));
+    tokens_ = was_unlimited ? static_cast<double>(burst_bytes_) :
+                              std::min(tokens_, static_cast<double>(burst_bytes_));
+  }
+  condition_variable_.notify_all();
+}
+
+void TokenBucket::set_bulk_share(double share) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bulk_share_ = std::max(kMinimumBulkShare, std::min(1.0, share));
+  }
+  condition_variable_.notify_all();
+}
+
+void TokenBucket::Consume(uint64_t bytes, NfsPriority priority) {
+  bool bulk(priority == NfsPriority::kForeground || priority == NfsPriority::kBackground);
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    if (bytes_per_second_ == 0)
+      return;
+    Refill(Clock::now());
+    double cost(bulk ? static_cast<double>(bytes) / bulk_share_ : static_cast<double>(bytes));
+    // Transfers larger than the burst would never fit, so only wait for a full bucket.
+    double needed(std::min(cost, static_cast<double>(burst_bytes_)));
+    if (!bulk || tokens_ >= needed) {
+      tokens_ -= cost;
+      return;
+    }
+    // Woken early if the limit or share changes.
+    std::chrono::microseconds wait(static_cast<int64_t>(
+        (needed - tokens_) * 1000000.0 / static_cast<double>(bytes_per_second_)) + 1);
+    condition_variable_.wait_for(lock, wait);
+  }
+}
+
+uint64_t TokenBucket::bytes_per_second() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_per_second_;
+}
+
+uint64_t TokenBucket::burst_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return burst_bytes_;
+}
+
+double TokenBucket::bulk_share() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bulk_share_;
+}
+
+void TokenBucket::Refill(Clock::time_point now) {
+  double elapsed(std::chrono::duration<double>(now - last_refill_).count());
+  last_refill_ = now;
+  tokens_ = std::min(static_cast<double>(burst_bytes_),
+                     tokens_ + elapsed * static_cast<double>(bytes_per_second_));
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,71 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_TOKEN_BUCKET_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_TOKEN_BUCKET_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "maidsafe/lifestuff/detail/nfs_scheduler.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Limits the rate of data transferred in one direction.  The bucket fills at the limit up to
+// 'burst_bytes', and each transfer takes its size from it.  Interactive and session-critical
+// transfers are charged but never delayed, so they can use the burst at once.  Foreground and
+// background transfers wait for the bucket to hold their size, and are charged in inverse
+// proportion to the bulk share, which is lowered while the network is unhealthy.  A limit of zero
+// means unlimited.
+class TokenBucket {
+ public:
+  TokenBucket();
+  ~TokenBucket() {}
+
+  void SetLimit(uint64_t bytes_per_second, uint64_t burst_bytes);
+  // 'share' is clamped to [kMinimumBulkShare, 1].
+  void set_bulk_share(double share);
+  // Blocks until 'bytes' may be transferred by an operation of class 'priority'.
+  void Consume(uint64_t bytes, NfsPriority priority);
+
+  uint64_t bytes_per_second() const;
+  uint64_t burst_bytes() const;
+  double bulk_share() const;
+
+  static const double kMinimumBulkShare;
+
+ private:
+  TokenBucket(const TokenBucket&);
+  TokenBucket& operator=(const TokenBucket&);
+
+  typedef std::chrono::steady_clock Clock;
+
+  void Refill(Clock::time_point now);
+
+  uint64_t bytes_per_second_, burst_bytes_;
+  double bulk_share_, tokens_;
+  Clock::time_point last_refill_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_variable_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_TOKEN_BUCKET_H_
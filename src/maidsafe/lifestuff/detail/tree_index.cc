@@ -0,0 +1,217 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/tree_index.h"
+
+#include <limits>
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/lifestuff/detail/data_atlas.pb.h"
+#include "maidsafe/lifestuff/detail/encrypted_file.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+namespace {
+
+std::string Key(const fs::path& path) {
+  return path.generic_string();
+}
+
+std::string ParentKey(const fs::path& path) {
+  return path.parent_path().generic_string();
+}
+
+}  // unnamed namespace
+
+TreeIndex::TreeIndex() : directories_(), generation_(0), mutex_() {}
+
+bool TreeIndex::Load(const fs::path& index_path, const Identity& secret) {
+  DirectoryMap directories;
+  try {
+    TreeIndexData index_data;
+    if (!index_data.ParseFromString(ReadEncryptedFile(index_path, secret, "tree index"))) {
+      LOG(kWarning) << "Failed to parse tree index at " << index_path;
+      return false;
+    }
+    for (int i(0); i != index_data.directories_size(); ++i) {
+      const TreeIndexData::Directory& directory(index_data.directories(i));
+      Listing& listing(directories[directory.path()]);
+      // Listings saved before they were stamped are never served, so will be re-read.
+      listing.last_write_time = directory.last_write_time();
+      EntryMap& entries(listing.entries);
+      for (int j(0); j != directory.entries_size(); ++j) {
+        DirectoryEntry entry;
+        entry.name = directory.entries(j).name();
+        entry.is_directory = directory.entries(j).is_directory();
+        entry.size = directory.entries(j).size();
+        entry.last_write_time = directory.entries(j).last_write_time();
+        entries[entry.name] = entry;
+      }
+    }
+  }
+  catch(const std::exception& e) {
+    LOG(kInfo) << "No usable tree index at " << index_path << ": " << e.what();
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  directories_.swap(directories);
+  ++generation_;
+  return true;
+}
+
+void TreeIndex::Save(const fs::path& index_path, const Identity& secret) const {
+  TreeIndexData index_data;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& directory : directories_) {
+      TreeIndexData::Directory* directory_data(index_data.add_directories());
+      directory_data->set_path(directory.first);
+      directory_data->set_last_write_time(directory.second.last_write_time);
+      for (auto& named_entry : directory.second.entries) {
+        const DirectoryEntry& entry(named_entry.second);
+        TreeIndexData::Entry* entry_data(directory_data->add_entries());
+        entry_data->set_name(entry.name);
+        entry_data->set_is_directory(entry.is_directory);
+        entry_data->set_size(entry.size);
+        entry_data->set_last_write_time(entry.last_write_time);
+      }
+    }
+  }
+  WriteEncryptedFile(index_path, secret, "tree index", index_data.SerializeAsString());
+}
+
+bool TreeIndex::Contains(const fs::path& directory) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return directories_.count(Key(directory)) != 0;
+}
+
+bool TreeIndex::List(const fs::path& directory,
+                     int64_t last_write_time,
+                     std::vector<DirectoryEntry>* entries) const {
+  return List(directory, last_write_time, "", std::numeric_limits<size_t>::max(), entries);
+}
+
+bool TreeIndex::List(const fs::path& directory,
+                     int64_t last_write_time,
+                     const std::string& start_after,
+                     size_t max_entries,
+                     std::vector<DirectoryEntry>* entries) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(directories_.find(Key(directory)));
+  if (itr == directories_.end() || itr->second.last_write_time != last_write_time)
+    return false;
+  entries->clear();
+  const EntryMap& listing(itr->second.entries);
+  for (auto entry_itr(listing.upper_bound(start_after));
+       entry_itr != listing.end() && entries->size() < max_entries; ++entry_itr) {
+    entries->push_back(entry_itr->second);
+  }
+  return true;
+}
+
+TreeIndex::Result TreeIndex::Find(const fs::path& path,
+                                  int64_t parent_last_write_time,
+                                  DirectoryEntry* entry) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(directories_.find(ParentKey(path)));
+  if (itr == directories_.end() || itr->second.last_write_time != parent_last_write_time)
+    return Result::kMiss;
+  auto entry_itr(itr->second.entries.find(path.filename().string()));
+  if (entry_itr == itr->second.entries.end())
+    return Result::kNotFound;
+  *entry = entry_itr->second;
+  return Result::kFound;
+}
+
+uint64_t TreeIndex::generation() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return generation_;
+}
+
+void TreeIndex::Replace(const fs::path& directory,
+                        const std::vector<DirectoryEntry>& entries,
+                        int64_t last_write_time,
+                        uint64_t generation) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (generation != generation_)
+    return;
+  EntryMap new_entries;
+  for (auto& entry : entries)
+    new_entries[entry.name] = entry;
+  std::string key(Key(directory));
+  auto itr(directories_.find(key));
+  if (itr != directories_.end()) {
+    for (auto& old_entry : itr->second.entries) {
+      if (!old_entry.second.is_directory)
+        continue;
+      auto new_entry(new_entries.find(old_entry.first));
+      if (new_entry == new_entries.end() || !new_entry->second.is_directory)
+        EraseSubtree(Key(directory / old_entry.first));
+    }
+  }
+  Listing& listing(directories_[key]);
+  listing.last_write_time = last_write_time;
+  listing.entries.swap(new_entries);
+}
+
+void TreeIndex::Upsert(const fs::path& path, const DirectoryEntry& entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  auto itr(directories_.find(ParentKey(path)));
+  if (itr == directories_.end())
+    return;
+  EntryMap& entries(itr->second.entries);
+  auto old_entry(entries.find(entry.name));
+  if (old_entry != entries.end() && old_entry->second.is_directory && !entry.is_directory)
+    EraseSubtree(Key(path));
+  entries[entry.name] = entry;
+}
+
+void TreeIndex::Invalidate(const fs::path& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  directories_.erase(ParentKey(path));
+  EraseSubtree(Key(path));
+}
+
+void TreeIndex::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  directories_.clear();
+}
+
+size_t TreeIndex::directory_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return directories_.size();
+}
+
+void TreeIndex::EraseSubtree(const std::string& directory) {
+  if (directory.empty()) {
+    directories_.clear();
+    return;
+  }
+  directories_.erase(directory);
+  std::string prefix(directory + '/');
+  auto itr(directories_.lower_bound(prefix));
+  while (itr != directories_.end() && itr->first.compare(0, prefix.size(), prefix) == 0)
+    itr = directories_.erase(itr);
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,114 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_TREE_INDEX_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_TREE_INDEX_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/types.h"
+
+#include "maidsafe/lifestuff/lifestuff.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// A local copy of the drive's directory listings, keyed by path relative to owner_path(), so that
+// listings and attributes can be served without going through the mounted file system.  Listings
+// can be saved to and loaded from an encrypted file to survive between mounts.
+//
+// Listings read from the drive should be added via Replace using the generation() taken before the
+// read started; if any Invalidate or Upsert call happened in between, the listing may be stale and
+// is dropped.  Each listing is held ordered by name, so lookups and single-entry updates are
+// O(log n) in the size of the directory and listings can be read a page at a time.
+//
+// Each listing is stamped with its directory's last write time and only served to callers passing
+// that same time, so changes made through the mounted file system, which bypass this index, are
+// picked up once they move the directory's write time on.
+class TreeIndex {
+ public:
+  enum class Result { kMiss, kFound, kNotFound };
+
+  TreeIndex();
+  ~TreeIndex() {}
+
+  // Replaces the index with the one saved at 'index_path'.  Returns false, leaving the index empty,
+  // if there is no saved index or it can't be decrypted with 'secret'.
+  bool Load(const boost::filesystem::path& index_path, const Identity& secret);
+  void Save(const boost::filesystem::path& index_path, const Identity& secret) const;
+
+  bool Contains(const boost::filesystem::path& directory) const;
+  // Returns false if no listing of 'directory' stamped with 'last_write_time' is held.
+  bool List(const boost::filesystem::path& directory,
+            int64_t last_write_time,
+            std::vector<DirectoryEntry>* entries) const;
+  // As above, but returns at most 'max_entries' entries, starting with the first one named after
+  // 'start_after'.
+  bool List(const boost::filesystem::path& directory,
+            int64_t last_write_time,
+            const std::string& start_after,
+            size_t max_entries,
+            std::vector<DirectoryEntry>* entries) const;
+  // Returns kMiss unless a listing of the parent of 'path' stamped with 'parent_last_write_time'
+  // is held.
+  Result Find(const boost::filesystem::path& path,
+              int64_t parent_last_write_time,
+              DirectoryEntry* entry) const;
+
+  uint64_t generation() const;
+  // Sets the listing of 'directory'.  Indexed subdirectories no longer present in 'entries' are
+  // dropped along with their subtrees.
+  void Replace(const boost::filesystem::path& directory,
+               const std::vector<DirectoryEntry>& entries,
+               int64_t last_write_time,
+               uint64_t generation);
+  // Adds or updates the entry for 'path' if its parent's listing is held.  The listing keeps its
+  // stamp, so is re-read if the change moved the parent's write time on.
+  void Upsert(const boost::filesystem::path& path, const DirectoryEntry& entry);
+  // Drops the listing containing 'path' and, if 'path' is a directory, all listings below it.
+  void Invalidate(const boost::filesystem::path& path);
+  void Clear();
+
+  size_t directory_count() const;
+
+ private:
+  TreeIndex(const TreeIndex&);
+  TreeIndex& operator=(const TreeIndex&);
+
+  typedef std::map<std::string, DirectoryEntry> EntryMap;
+  struct Listing {
+    Listing() : last_write_time(0), entries() {}
+    int64_t last_write_time;
+    EntryMap entries;
+  };
+  typedef std::map<std::string, Listing> DirectoryMap;
+
+  void EraseSubtree(const std::string& directory);
+
+  DirectoryMap directories_;
+  uint64_t generation_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_TREE_INDEX_H_
@@ -0,0 +1,86 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/upload_journal.h"
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+UploadJournal::UploadJournal(const fs::path& journal_path)
+    : kJournalPath_(journal_path),
+      confirmed_(),
+      kResumedCount_(Load()),
+      journal_(),
+      mutex_() {
+  boost::system::error_code error_code;
+  fs::create_directories(kJournalPath_.parent_path(), error_code);
+  bool existing(fs::file_size(kJournalPath_, error_code) != 0 && !error_code);
+  journal_.open(kJournalPath_, std::ios_base::out | std::ios_base::app);
+  if (!journal_.good())
+    LOG(kWarning) << "Failed to open " << kJournalPath_ << "; this import won't be resumable.";
+  // Terminate any entry left incomplete by a crash so it doesn't run into the next one.
+  if (existing)
+    journal_ << std::endl;
+  if (kResumedCount_ != 0)
+    LOG(kInfo) << "Resuming upload with " << kResumedCount_ << " chunks already stored.";
+}
+
+size_t UploadJournal::Load() {
+  fs::ifstream journal(kJournalPath_);
+  std::string line;
+  while (std::getline(journal, line)) {
+    // A line cut short by a crash fails to decode and is ignored.
+    try {
+      if (!line.empty())
+        confirmed_.insert(DecodeFromHex(line));
+    }
+    catch(const std::exception&) {}
+  }
+  return confirmed_.size();
+}
+
+bool UploadJournal::Contains(const std::string& chunk_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return confirmed_.count(chunk_name) != 0;
+}
+
+void UploadJournal::Record(const std::string& chunk_name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!confirmed_.insert(chunk_name).second)
+    return;
+  journal_ << EncodeToHex(chunk_name) << std::endl;
+}
+
+std::vector<std::string> UploadJournal::chunk_names() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::vector<std::string>(confirmed_.begin(), confirmed_.end());
+}
+
+void UploadJournal::Complete() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  journal_.close();
+  boost::system::error_code error_code;
+  fs::remove(kJournalPath_, error_code);
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
@@ -0,0 +1,66 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_UPLOAD_JOURNAL_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_UPLOAD_JOURNAL_H_
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Records the chunks of one file import which the network has confirmed as stored.  Each
+// confirmation is appended and flushed as it arrives, so if the import is interrupted, a later
+// import of the same file skips every chunk already recorded.  Chunk names are content hashes,
+// so a recorded chunk is valid however the file's other chunks have changed since.  UserStorage
+// also keeps one of chunks whose puts failed, so that they can be put again on the next mount.
+class UploadJournal {
+ public:
+  // Loads any entries left in 'journal_path' by an earlier, interrupted import.
+  explicit UploadJournal(const boost::filesystem::path& journal_path);
+  ~UploadJournal() {}
+
+  bool Contains(const std::string& chunk_name);
+  // Safe to call concurrently, e.g. from put replies.
+  void Record(const std::string& chunk_name);
+  std::vector<std::string> chunk_names();
+  // Deletes the journal file; call once the import no longer needs resuming.
+  void Complete();
+  // Number of entries loaded from an earlier import.
+  size_t resumed_count() const { return kResumedCount_; }
+
+ private:
+  UploadJournal(const UploadJournal&);
+  UploadJournal& operator=(const UploadJournal&);
+
+  size_t Load();
+
+  const boost::filesystem::path kJournalPath_;
+  std::set<std::string> confirmed_;
+  const size_t kResumedCount_;
+  boost::filesystem::ofstream journal_;
+  std::mutex mutex_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_UPLOAD_JOURNAL_H_
@@ -15,11 +15,20 @@ License.
 
 #include "maidsafe/lifestuff/detail/user_storage.h"
 
+#include <algorithm>
+#include <ctime>
+#include <exception>
 #include <limits>
 #include <list>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
 
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
@@ -30,7 +39,11 @@ License.
 #include "maidsafe/passport/passport.h"
 
 #include "maidsafe/lifestuff/detail/data_atlas.pb.h"
+#include "maidsafe/lifestuff/detail/directory_exporter.h"
+#include "maidsafe/lifestuff/detail/directory_importer.h"
+#include "maidsafe/lifestuff/detail/file_encryptor.h"
 #include "maidsafe/lifestuff/detail/session.h"
+#include "maidsafe/lifestuff/detail/snapshot_manifest.h"
 #include "maidsafe/lifestuff/detail/utils.h"
 
 namespace fs = boost::filesystem;
@@ -40,19 +53,136 @@ namespace lifestuff {
 
 const NonEmptyString kDriveLogo("Lifestuff Drive");
 const boost::filesystem::path kLifeStuffConfigPath("LifeStuff-Config");
+const boost::filesystem::path kFlushJournalName("unmount.journal");
+const boost::filesystem::path kTreeIndexName("tree.index");
+const boost::filesystem::path kContentIndexName("content.index");
+const boost::filesystem::path kChunkFilterName("chunks.filter");
+const boost::filesystem::path kUploadJournalsName("uploads");
+const boost::filesystem::path kOfflineJournalName("offline.journal");
+const boost::filesystem::path kRetryJournalName("retry.journal");
+const boost::filesystem::path kPinSetName("pins");
+const size_t kMetadataCacheCapacity(100000);
+const size_t kContentIndexCapacity(100000);
+// About 5 MB, enough for 1 TB of 1 MB chunks.
+const uint64_t kChunkFilterCapacity(1 << 20);
+const double kChunkFilterFalsePositiveRate(1e-9);
+const uint64_t kScrubBytesPerSecond(8 * 1024 * 1024);
+// Each step of a scrub checks at most this many chunks, taking a few seconds at the scrub rate,
+// before re-posting itself so that other background work can run in between.
+const size_t kScrubChunksPerStep(16);
 
-UserStorage::UserStorage()
+namespace {
+
+void AddChunkNames(const std::string& serialised_data_map, std::set<std::string>* chunk_names) {
+  if (serialised_data_map.empty())
+    return;
+  encrypt::DataMapPtr data_map(ParseDataMap(serialised_data_map));
+  for (auto& chunk : data_map->chunks)
+    chunk_names->insert(chunk.hash);
+}
+
+}  // unnamed namespace
+
+UserStorage::UserStorage(const OperationsPendingFunction& operations_pending)
     : mount_status_(false),
+      shared_resources_(SharedResources::Get()),
+      flusher_(operations_pending),
+      mount_profile_(),
+      space_accountant_(),
+      chunk_filter_(),
+      data_store_(),
+      chunk_uploader_(),
+      chunk_fetcher_(),
+      pin_fetcher_(),
+      chunk_scrubber_(),
       mount_path_(),
+      upload_journals_path_(),
+      retry_journal_path_(),
       drive_(),
-      mount_thread_() {}
+      mount_thread_(),
+      drive_mutex_(),
+      tree_index_(),
+      content_index_(),
+      metadata_cache_(),
+      offline_journal_(),
+      retry_journal_(),
+      pin_set_(),
+      stop_background_tasks_(false),
+      offline_(false),
+      network_mutex_(),
+      background_tasks_(shared_resources_->background_io_service()),
+      flushed_space_(std::make_shared<FlushedSpace>()) {}
+
+UserStorage::~UserStorage() {
+  stop_background_tasks_ = true;
+}
 
-void UserStorage::MountDrive(ClientNfs& client_nfs, Session& session) {
+void UserStorage::MountDrive(ClientNfs& client_nfs,
+                             Session& session,
+                             const MountProfile& profile) {
   if (mount_status_)
     return;
-  boost::filesystem::path data_store_path(
-      GetHomeDir() / kAppHomeDirectory / session.session_name().string());
+  mount_profile_ = ResolveMountProfile(profile, shared_resources_->worker_count());
+  LOG(kInfo) << "Mounting with " << DebugString(mount_profile_);
+  metadata_cache_.reset(new MetadataCache(
+      std::chrono::milliseconds(mount_profile_.attribute_timeout_ms),
+      std::chrono::milliseconds(mount_profile_.negative_timeout_ms),
+      kMetadataCacheCapacity));
+  // A previous unmount of this session may still be releasing the mount path, and has yet to
+  // record its space figures.
+  WaitForPendingFlush(session);
+  boost::filesystem::path data_store_path(SessionFilePath(session, fs::path()));
   DiskUsage disk_usage(10995116277760);  // arbitrary 10GB
+  data_store_.reset(new PermanentStore(data_store_path, disk_usage));
+  upload_journals_path_ = data_store_path / kUploadJournalsName;
+  space_accountant_ = std::make_shared<SpaceAccountant>(session.max_space(), session.used_space());
+  chunk_filter_ = std::make_shared<ChunkFilter>(kChunkFilterCapacity,
+                                                kChunkFilterFalsePositiveRate);
+  chunk_filter_->Load(SessionFilePath(session, kChunkFilterName));
+  content_index_ = std::make_shared<ContentIndex>(kContentIndexCapacity);
+  offline_journal_ = std::make_shared<OfflineJournal>(data_store_path / kOfflineJournalName);
+  retry_journal_path_ = data_store_path / kRetryJournalName;
+  retry_journal_ = std::make_shared<UploadJournal>(retry_journal_path_);
+  // Nobody waits on write-back uploads, so they yield to other mounts' foreground transfers.
+  NfsPriority upload_priority(mount_profile_.durability_mode == DurabilityMode::kWriteBack ?
+                              NfsPriority::kBackground : NfsPriority::kForeground);
+  chunk_uploader_.reset(new ChunkUploader(client_nfs,
+                                          *data_store_,
+                                          session.passport().Get<passport::Pmid>(true).name(),
+                                          *space_accountant_,
+                                          *chunk_filter_,
+                                          shared_resources_->nfs_scheduler(),
+                                          shared_resources_->upload_bucket(),
+                                          upload_priority,
+                                          mount_profile_.max_uploads_in_flight));
+  chunk_fetcher_.reset(new ChunkFetcher(client_nfs,
+                                        *data_store_,
+                                        shared_resources_->nfs_scheduler(),
+                                        shared_resources_->download_bucket(),
+                                        NfsPriority::kForeground,
+                                        mount_profile_.max_fetches_in_flight));
+  // Refreshing pins in the background mustn't hold up fetches someone is waiting for.
+  pin_fetcher_.reset(new ChunkFetcher(client_nfs,
+                                      *data_store_,
+                                      shared_resources_->nfs_scheduler(),
+                                      shared_resources_->download_bucket(),
+                                      NfsPriority::kBackground,
+                                      mount_profile_.max_fetches_in_flight));
+  chunk_scrubber_.reset(new ChunkScrubber(*data_store_, kScrubBytesPerSecond));
+  chunk_uploader_->RecordFailuresIn(retry_journal_);
+  // Data maps may already refer to chunks whose puts failed, so the flush journal of an unmount
+  // which didn't complete is kept until they have been put.
+  bool flush_interrupted(flusher_.Interrupted(SessionFilePath(session, kFlushJournalName)));
+  if (flush_interrupted)
+    LOG(kWarning) << "Previous unmount of this session did not complete.";
+  if (RetryFailedPuts()) {
+    if (flush_interrupted) {
+      boost::system::error_code error_code;
+      fs::remove(SessionFilePath(session, kFlushJournalName), error_code);
+    }
+  } else {
+    LOG(kWarning) << "Puts which failed in an earlier session will be retried on the next mount.";
+  }
 #ifdef WIN32
   std::uint32_t drive_letters, mask = 0x4, count = 2;
   drive_letters = GetLogicalDrives();
@@ -66,7 +196,6 @@ void UserStorage::MountDrive(ClientNfs& client_nfs, Session& session) {
   }
   char drive_name[3] = {'A' + static_cast<char>(count), ':', '\0'};
   mount_path_ = drive_name;
-  data_store_.reset(new PermanentStore(data_store_path, disk_usage));
   drive_.reset(new MaidDrive(client_nfs,
                              *data_store_,
                              session.passport().Get<Maid>(true),
@@ -102,24 +231,470 @@ void UserStorage::MountDrive(ClientNfs& client_nfs, Session& session) {
                                         }));
   mount_status_ = drive_->WaitUntilMounted();
 #endif
+  if (mount_status_) {
+    if (tree_index_.Load(SessionFilePath(session, kTreeIndexName), session.unique_user_id()))
+      LOG(kInfo) << "Loaded " << tree_index_.directory_count() << " indexed directories.";
+    content_index_->Load(SessionFilePath(session, kContentIndexName), session.unique_user_id());
+    pin_set_.Load(SessionFilePath(session, kPinSetName), session.unique_user_id());
+    stop_background_tasks_ = false;
+    PostBackgroundTask("Tree index reconciliation", [this] { ReconcileTreeIndex(); });
+    // Changes journalled by an earlier session are replayed now if the network is available.
+    std::lock_guard<std::mutex> lock(network_mutex_);
+    if (offline_) {
+      chunk_uploader_->GoOffline(offline_journal_);
+    } else {
+      PostBackgroundTask("Offline change replay", [this] { ReplayOfflineChanges(); });
+      PostBackgroundTask("Pin refresh", [this] { RefreshPins(); });
+    }
+    PostBackgroundTask("Chunk store scrub", [this] { ScrubChunkStore(); });
+  }
 }
 
 void UserStorage::UnMountDrive(Session& session) {
   if (!mount_status_)
     return;
-  int64_t max_space(0), used_space(0);
-#ifdef WIN32
-  drive_->Unmount(max_space, used_space);
-#else
-  drive_->Unmount(max_space, used_space);
-  drive_->WaitUntilUnMounted();
-  mount_thread_.join();
-  boost::system::error_code error_code;
-  fs::remove_all(mount_path_, error_code);
+  {
+    std::lock_guard<std::mutex> lock(network_mutex_);
+    mount_status_ = false;
+  }
+  stop_background_tasks_ = true;
+  // Background tasks log their own failures, so leave nothing to rethrow.
+  background_tasks_.Wait();
+  // Anything still journalled is replayed or retried on the next mount.
+  offline_journal_.reset();
+  retry_journal_.reset();
+  tree_index_.Save(SessionFilePath(session, kTreeIndexName), session.unique_user_id());
+  tree_index_.Clear();
+  pin_set_.Save(SessionFilePath(session, kPinSetName), session.unique_user_id());
+  metadata_cache_->Clear();
+  chunk_fetcher_.reset();
+  pin_fetcher_.reset();
+  chunk_scrubber_.reset();
+  // Ownership of the drive, its store and its mount thread passes to the flush operation so that
+  // a subsequent MountDrive can proceed with fresh instances.
+  std::shared_ptr<MaidDrive> drive(drive_.release());
+  std::shared_ptr<PermanentStore> data_store(data_store_.release());
+  std::shared_ptr<ChunkUploader> chunk_uploader(chunk_uploader_.release());
+  std::shared_ptr<SpaceAccountant> space_accountant(space_accountant_);
+  space_accountant_.reset();
+  std::shared_ptr<ChunkFilter> chunk_filter(chunk_filter_);
+  chunk_filter_.reset();
+  // The content index is saved once outstanding uploads have been confirmed, as imports which
+  // didn't wait for them only add their content then.
+  std::shared_ptr<ContentIndex> content_index(content_index_);
+  content_index_.reset();
+  boost::filesystem::path chunk_filter_path(SessionFilePath(session, kChunkFilterName)),
+                          content_index_path(SessionFilePath(session, kContentIndexName));
+  Identity unique_user_id(session.unique_user_id());
+  std::shared_ptr<std::thread> mount_thread(std::make_shared<std::thread>(
+                                                std::move(mount_thread_)));
+  boost::filesystem::path mount_path(mount_path_);
+  std::shared_ptr<FlushedSpace> flushed_space(flushed_space_);
+  flusher_.Enqueue(SessionFilePath(session, kFlushJournalName),
+                   session.session_name().string(),
+                   [drive, data_store, chunk_uploader, space_accountant, chunk_filter,
+                    content_index, chunk_filter_path, content_index_path, unique_user_id,
+                    mount_thread, mount_path, flushed_space] {
+                     // A failure leaves the flush journal for the next mount, but is only rethrown
+                     // once the drive has been unmounted, its thread joined and the space figures
+                     // recorded.
+                     std::exception_ptr error;
+                     try {
+                       chunk_uploader->WaitForUploads();
+                       LOG(kInfo) << "Chunk filter skipped " << chunk_uploader->chunks_filtered()
+                                  << " puts; " << chunk_filter->entry_count()
+                                  << " entries, estimated false positive rate "
+                                  << chunk_filter->false_positive_rate();
+                     }
+                     catch(...) {
+                       error = std::current_exception();
+                     }
+                     // The filter and index only hold confirmed chunks, so are saved even if the
+                     // last uploads failed.
+                     chunk_filter->Save(chunk_filter_path);
+                     content_index->Save(content_index_path, unique_user_id);
+                     int64_t max_space(0), used_space(0);
+                     bool unmounted(false);
+                     try {
+                       drive->Unmount(max_space, used_space);
+                       unmounted = true;
+                     }
+                     catch(...) {
+                       if (!error)
+                         error = std::current_exception();
+                     }
+#ifndef WIN32
+                     if (unmounted) {
+                       drive->WaitUntilUnMounted();
+                       if (mount_thread->joinable())
+                         mount_thread->join();
+                       boost::system::error_code error_code;
+                       fs::remove_all(mount_path, error_code);
+                     } else if (mount_thread->joinable()) {
+                       // Joining a drive which failed to unmount could block forever.
+                       LOG(kError) << "Failed to unmount " << mount_path;
+                       mount_thread->detach();
+                     }
 #endif
-  mount_status_ = false;
-  session.set_max_space(max_space);
-  session.set_used_space(used_space);
+                     // The drive only sees what was written through the mount, so chunks stored
+                     // directly by UserStorage may not be reflected in its figure.
+                     {
+                       std::lock_guard<std::mutex> lock(flushed_space->mutex);
+                       flushed_space->recorded = true;
+                       flushed_space->max_space = max_space;
+                       flushed_space->used_space = std::max(used_space,
+                                                            space_accountant->used_space());
+                     }
+                     if (error)
+                       std::rethrow_exception(error);
+                   });
+}
+
+bool UserStorage::RetryFailedPuts() {
+  std::vector<std::string> chunk_names(retry_journal_->chunk_names());
+  if (chunk_names.empty())
+    return true;
+  {
+    std::lock_guard<std::mutex> lock(network_mutex_);
+    if (offline_)
+      return false;
+  }
+  LOG(kInfo) << "Retrying " << chunk_names.size() << " puts which failed in an earlier session.";
+  try {
+    chunk_uploader_->Retry(chunk_names);
+    chunk_uploader_->WaitForUploads();
+  }
+  catch(const std::exception& e) {
+    LOG(kError) << "Failed to retry puts: " << e.what();
+    return false;
+  }
+  // Every recorded chunk is now stored; later failures start a fresh journal.
+  retry_journal_->Complete();
+  retry_journal_ = std::make_shared<UploadJournal>(retry_journal_path_);
+  chunk_uploader_->RecordFailuresIn(retry_journal_);
+  return true;
+}
+
+void UserStorage::WaitForPendingFlush(Session& session) {
+  flusher_.WaitUntilFlushed();
+  std::lock_guard<std::mutex> lock(flushed_space_->mutex);
+  if (!flushed_space_->recorded)
+    return;
+  session.set_max_space(flushed_space_->max_space);
+  session.set_used_space(flushed_space_->used_space);
+  flushed_space_->recorded = false;
+}
+
+void UserStorage::ImportDirectory(const fs::path& local_path,
+                                  const fs::path& drive_path,
+                                  const TransferProgressFunction& progress) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  fs::path destination(owner_path() / drive_path);
+  boost::system::error_code error_code;
+  fs::create_directories(destination, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to create " << destination << ": " << error_code.message();
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+  InvalidateMetadata(drive_path);
+  DirectoryImporter importer(*data_store_,
+                             *chunk_uploader_,
+                             shared_resources_->io_service(),
+                             mount_profile_,
+                             upload_journals_path_,
+                             *content_index_);
+  importer.Import(
+      local_path,
+      [&destination](const fs::path& relative_path) {
+        boost::system::error_code error_code;
+        fs::create_directory(destination / relative_path, error_code);
+        if (error_code) {
+          LOG(kError) << "Failed to create " << destination / relative_path << ": "
+                      << error_code.message();
+          ThrowError(CommonErrors::filesystem_io_error);
+        }
+      },
+      [this, &drive_path](const std::vector<DirectoryImporter::DataMapEntry>& entries) {
+        for (auto& entry : entries)
+          InsertDataMap(drive_path / entry.first, entry.second);
+      },
+      progress);
+}
+
+void UserStorage::ImportFile(const fs::path& local_path,
+                             const fs::path& drive_path,
+                             const TransferProgressFunction& progress) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  DirectoryImporter importer(*data_store_,
+                             *chunk_uploader_,
+                             shared_resources_->io_service(),
+                             mount_profile_,
+                             upload_journals_path_,
+                             *content_index_);
+  InsertDataMap(drive_path, importer.ImportFile(local_path, progress));
+}
+
+void UserStorage::ExportDirectory(const fs::path& drive_path,
+                                  const fs::path& local_path,
+                                  const TransferProgressFunction& progress) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  DirectoryExporter exporter(*data_store_,
+                             *chunk_fetcher_,
+                             shared_resources_->io_service(),
+                             mount_profile_);
+  exporter.Export(owner_path() / drive_path,
+                  local_path,
+                  [this, &drive_path](const fs::path& relative_path) {
+                    return GetDataMap(drive_path / relative_path);
+                  },
+                  progress);
+}
+
+std::string UserStorage::GetDataMap(const fs::path& drive_path) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  std::string serialised_data_map;
+  std::lock_guard<std::mutex> lock(drive_mutex_);
+  drive_->GetDataMap(DriveRelativePath(drive_path), &serialised_data_map);
+  return serialised_data_map;
+}
+
+void UserStorage::InsertDataMap(const fs::path& drive_path,
+                                const std::string& serialised_data_map) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  std::string replaced_data_map;
+  try {
+    DirectoryEntry entry;
+    if (FindDirectoryEntry(drive_path, &entry) && !entry.is_directory)
+      replaced_data_map = GetDataMap(drive_path);
+  }
+  catch(const std::exception& e) {
+    LOG(kWarning) << "Failed to get replaced data map of " << drive_path << ": " << e.what();
+  }
+  if (serialised_data_map.empty()) {
+    fs::ofstream empty_file(owner_path() / drive_path, std::ios_base::out | std::ios_base::trunc);
+    if (!empty_file) {
+      LOG(kError) << "Failed to create " << owner_path() / drive_path;
+      ThrowError(CommonErrors::filesystem_io_error);
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(drive_mutex_);
+    drive_->InsertDataMap(DriveRelativePath(drive_path), NonEmptyString(serialised_data_map));
+  }
+  if (offline_) {
+    offline_journal_->RecordChange(drive_path, serialised_data_map);
+  } else if (pin_set_.IsPinned(drive_path)) {
+    PostBackgroundTask("Pinned file refresh",
+                       [this, drive_path] { RefreshPinnedFile(drive_path); });
+  }
+  UpdateMetadata(drive_path);
+  OnDataMapReplaced(replaced_data_map, serialised_data_map);
+}
+
+void UserStorage::CopyFile(const fs::path& source_path, const fs::path& destination_path) {
+  InsertDataMap(destination_path, GetDataMap(source_path));
+}
+
+void UserStorage::AppendToFile(const fs::path& drive_path, const std::string& content) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  if (content.empty())
+    return;
+  std::string serialised_data_map(GetDataMap(drive_path));
+  encrypt::DataMapPtr data_map(new encrypt::DataMap);
+  if (!serialised_data_map.empty())
+    data_map = ParseDataMap(serialised_data_map);
+  std::set<std::string> existing_chunks;
+  for (auto& chunk : data_map->chunks)
+    existing_chunks.insert(chunk.hash);
+  encrypt::DataMap reencrypted_chunks;
+  reencrypted_chunks.chunks = ChunksReencryptedByAppend(*data_map);
+  chunk_fetcher_->Fetch(reencrypted_chunks);
+
+  AppendContent(data_map, content, *data_store_);
+  std::vector<encrypt::ChunkDetails> new_chunks;
+  for (auto& chunk : data_map->chunks) {
+    if (existing_chunks.count(chunk.hash) == 0)
+      new_chunks.push_back(chunk);
+  }
+  chunk_uploader_->Upload(new_chunks);
+  if (mount_profile_.durability_mode == DurabilityMode::kWriteThrough)
+    chunk_uploader_->WaitForUploads();
+  InsertDataMap(drive_path, SerialiseDataMap(*data_map));
+}
+
+void UserStorage::Sync() {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  if (mount_profile_.durability_mode != DurabilityMode::kWriteBack)
+    chunk_uploader_->WaitForUploads();
+}
+
+void UserStorage::OnNetworkHealthChange(int network_health) {
+  std::lock_guard<std::mutex> lock(network_mutex_);
+  bool offline(network_health < 0);
+  if (offline == offline_)
+    return;
+  offline_ = offline;
+  if (!mount_status_)
+    return;
+  if (offline) {
+    LOG(kWarning) << "Network unavailable; drive changes will be journalled until it returns.";
+    chunk_uploader_->GoOffline(offline_journal_);
+  } else {
+    LOG(kInfo) << "Network available again; replaying changes made while offline.";
+    chunk_uploader_->GoOnline();
+    PostBackgroundTask("Offline change replay", [this] { ReplayOfflineChanges(); });
+    PostBackgroundTask("Pin refresh", [this] { RefreshPins(); });
+  }
+}
+
+void UserStorage::PinPath(const fs::path& drive_path) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  boost::system::error_code error_code;
+  if (!fs::exists(owner_path() / drive_path, error_code)) {
+    LOG(kError) << "Can't pin " << drive_path << ", no such file or directory.";
+    ThrowError(CommonErrors::no_such_element);
+  }
+  if (pin_set_.Pin(drive_path))
+    RefreshPin(drive_path, *chunk_fetcher_);
+}
+
+void UserStorage::UnpinPath(const fs::path& drive_path) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  pin_set_.Unpin(drive_path);
+}
+
+std::vector<fs::path> UserStorage::PinnedPaths() const {
+  return pin_set_.pins();
+}
+
+uint64_t UserStorage::pinned_space() const {
+  return mount_status_ ? pin_set_.pinned_bytes() : 0;
+}
+
+void UserStorage::TakeSnapshot(const std::string& name, Session& session) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  if (name.empty() || session.snapshots().count(name) != 0) {
+    LOG(kError) << "Invalid or existing snapshot name \"" << name << "\".";
+    ThrowError(CommonErrors::invalid_parameter);
+  }
+  std::vector<SnapshotEntry> entries;
+  fs::path root(owner_path());
+  fs::recursive_directory_iterator itr(root), end;
+  for (; itr != end; ++itr) {
+    fs::path relative_path(itr->path().string().substr(root.string().size() + 1));
+    fs::file_status status(itr->symlink_status());
+    if (fs::is_directory(status))
+      entries.push_back(SnapshotEntry(relative_path, true, ""));
+    else if (fs::is_regular_file(status))
+      entries.push_back(SnapshotEntry(relative_path, false, GetDataMap(relative_path)));
+  }
+  encrypt::DataMapPtr data_map(EncryptContent(SerialiseSnapshotManifest(entries), *data_store_));
+  chunk_uploader_->Upload(*data_map);
+  chunk_uploader_->WaitForUploads();
+  session.AddSnapshot(name, Session::SnapshotDetails(GetDurationSinceEpoch().total_seconds(),
+                                                     SerialiseDataMap(*data_map)));
+  LOG(kInfo) << "Took snapshot \"" << name << "\" of " << entries.size() << " entries.";
+}
+
+void UserStorage::RestoreSnapshot(const std::string& name,
+                                  const fs::path& drive_path,
+                                  Session& session) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  Session::SnapshotMap snapshots(session.snapshots());
+  auto snapshot(snapshots.find(name));
+  if (snapshot == snapshots.end()) {
+    LOG(kError) << "No snapshot named \"" << name << "\".";
+    ThrowError(CommonErrors::invalid_parameter);
+  }
+  encrypt::DataMapPtr data_map(ParseDataMap(snapshot->second.manifest_data_map));
+  std::string manifest;
+  chunk_fetcher_->ReadThrough(*data_map, [&] {
+                                manifest = DecryptContent(data_map, *data_store_);
+                              });
+  std::vector<SnapshotEntry> entries(ParseSnapshotManifest(manifest));
+
+  fs::path destination(owner_path() / drive_path);
+  InvalidateMetadata(drive_path);
+  boost::system::error_code error_code;
+  fs::create_directories(destination, error_code);
+  for (auto& entry : entries) {
+    if (error_code)
+      break;
+    if (entry.directory)
+      fs::create_directory(destination / entry.path, error_code);
+    else
+      InsertDataMap(drive_path / entry.path, entry.serialised_data_map);
+  }
+  if (error_code) {
+    LOG(kError) << "Failed to restore snapshot \"" << name << "\" to " << destination << ": "
+                << error_code.message();
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+}
+
+std::vector<DirectoryEntry> UserStorage::ListDirectory(const fs::path& drive_path) {
+  return ListDirectory(drive_path, "", std::numeric_limits<size_t>::max());
+}
+
+std::vector<DirectoryEntry> UserStorage::ListDirectory(const fs::path& drive_path,
+                                                       const std::string& start_after,
+                                                       size_t max_entries) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  std::vector<DirectoryEntry> entries;
+  int64_t last_write_time(0);
+  if (DirectoryWriteTime(drive_path, &last_write_time) &&
+      tree_index_.List(drive_path, last_write_time, start_after, max_entries, &entries)) {
+    return entries;
+  }
+  entries = ReadAndIndexDirectory(drive_path);
+  // The listing was just read in full, so take the page from it directly in case a concurrent
+  // invalidation stopped it being indexed.
+  std::sort(entries.begin(), entries.end(),
+            [](const DirectoryEntry& lhs, const DirectoryEntry& rhs) {
+              return lhs.name < rhs.name;
+            });
+  auto first(std::upper_bound(entries.begin(), entries.end(), start_after,
+                              [](const std::string& name, const DirectoryEntry& entry) {
+                                return name < entry.name;
+                              }));
+  auto last(static_cast<size_t>(entries.end() - first) > max_entries ? first + max_entries :
+                                                                        entries.end());
+  return std::vector<DirectoryEntry>(first, last);
+}
+
+DirectoryEntry UserStorage::GetDirectoryEntry(const fs::path& drive_path) {
+  if (!mount_status_)
+    ThrowError(CommonErrors::uninitialised);
+  DirectoryEntry entry;
+  if (drive_path.empty()) {
+    entry.is_directory = true;
+    return entry;
+  }
+  switch (metadata_cache_->Get(drive_path, &entry)) {
+    case MetadataCache::Result::kFound:
+      return entry;
+    case MetadataCache::Result::kNotFound:
+      ThrowError(CommonErrors::no_such_element);
+    default:
+      break;
+  }
+  if (!FindDirectoryEntry(drive_path, &entry)) {
+    metadata_cache_->PutNotFound(drive_path);
+    ThrowError(CommonErrors::no_such_element);
+  }
+  metadata_cache_->Put(drive_path, entry);
+  return entry;
 }
 
 boost::filesystem::path UserStorage::mount_path() {
@@ -138,5 +713,423 @@ bool UserStorage::mount_status() {
   return mount_status_;
 }
 
+std::shared_ptr<SharedResources> UserStorage::shared_resources() const {
+  return shared_resources_;
+}
+
+MountProfile UserStorage::mount_profile() const {
+  return mount_profile_;
+}
+
+int64_t UserStorage::used_space() const {
+  return space_accountant_ ? space_accountant_->used_space() : 0;
+}
+
+int64_t UserStorage::max_space() const {
+  return space_accountant_ ? space_accountant_->max_space() : 0;
+}
+
+double UserStorage::chunk_filter_false_positive_rate() const {
+  return chunk_filter_ ? chunk_filter_->false_positive_rate() : 0.0;
+}
+
+uint64_t UserStorage::chunks_filtered() const {
+  return chunk_uploader_ ? chunk_uploader_->chunks_filtered() : 0;
+}
+
+size_t UserStorage::pending_offline_entries() const {
+  uint64_t sequence(0);
+  return offline_journal_ ? offline_journal_->entries(&sequence).size() : 0;
+}
+
+ChunkScrubber::Progress UserStorage::scrub_progress() const {
+  return chunk_scrubber_ ? chunk_scrubber_->progress() : ChunkScrubber::Progress();
+}
+
+boost::filesystem::path UserStorage::SessionFilePath(const Session& session,
+                                                     const fs::path& name) const {
+  return GetHomeDir() / kAppHomeDirectory / session.session_name().string() / name;
+}
+
+std::vector<DirectoryEntry> UserStorage::ReadDirectory(const fs::path& drive_path) {
+  std::vector<DirectoryEntry> entries;
+  boost::system::error_code error_code;
+  fs::directory_iterator itr(owner_path() / drive_path, error_code), end;
+  for (; !error_code && itr != end; itr.increment(error_code)) {
+    DirectoryEntry entry;
+    if (ReadDirectoryEntry(itr->path(), &entry, error_code))
+      entries.push_back(entry);
+  }
+  if (error_code) {
+    LOG(kError) << "Failed to list " << owner_path() / drive_path << ": " << error_code.message();
+    ThrowError(CommonErrors::filesystem_io_error);
+  }
+  return entries;
+}
+
+bool UserStorage::ReadDirectoryEntry(const fs::path& absolute_path,
+                                     DirectoryEntry* entry,
+                                     boost::system::error_code& error_code) {
+  entry->name = absolute_path.filename().string();
+  fs::file_status status(fs::status(absolute_path, error_code));
+  entry->is_directory = fs::is_directory(status);
+  entry->size = 0;
+  if (fs::is_regular_file(status))
+    entry->size = fs::file_size(absolute_path, error_code);
+  if (!error_code)
+    entry->last_write_time = fs::last_write_time(absolute_path, error_code);
+  return !error_code;
+}
+
+bool UserStorage::DirectoryWriteTime(const fs::path& drive_path, int64_t* last_write_time) {
+  boost::system::error_code error_code;
+  *last_write_time = fs::last_write_time(owner_path() / drive_path, error_code);
+  return !error_code;
+}
+
+std::vector<DirectoryEntry> UserStorage::ReadAndIndexDirectory(const fs::path& drive_path) {
+  uint64_t generation(tree_index_.generation());
+  int64_t now(std::time(nullptr)), last_write_time(0);
+  bool stamped(DirectoryWriteTime(drive_path, &last_write_time));
+  std::vector<DirectoryEntry> entries(ReadDirectory(drive_path));
+  // Write times are only precise to the second, so a listing read during the second its directory
+  // last changed could miss a later change made in that second, and is left unindexed.
+  if (stamped && last_write_time < now)
+    tree_index_.Replace(drive_path, entries, last_write_time, generation);
+  return entries;
+}
+
+bool UserStorage::FindDirectoryEntry(const fs::path& drive_path, DirectoryEntry* entry) {
+  int64_t parent_last_write_time(0);
+  if (DirectoryWriteTime(drive_path.parent_path(), &parent_last_write_time)) {
+    switch (tree_index_.Find(drive_path, parent_last_write_time, entry)) {
+      case TreeIndex::Result::kNotFound:
+        return false;
+      case TreeIndex::Result::kFound: {
+        // Rewriting a file through the mounted drive leaves its directory's write time unchanged,
+        // so only the entry's presence is taken from the index.
+        boost::system::error_code error_code;
+        return ReadDirectoryEntry(owner_path() / drive_path, entry, error_code);
+      }
+      default:
+        break;
+    }
+  }
+  // Listing the parent indexes its siblings too, which are likely to be asked for next.
+  std::vector<DirectoryEntry> siblings;
+  try {
+    siblings = ListDirectory(drive_path.parent_path());
+  }
+  catch(const std::exception&) {
+    boost::system::error_code error_code;
+    if (fs::exists(owner_path() / drive_path.parent_path(), error_code))
+      throw;
+    return false;
+  }
+  std::string name(drive_path.filename().string());
+  for (auto& sibling : siblings) {
+    if (sibling.name == name) {
+      *entry = sibling;
+      return true;
+    }
+  }
+  return false;
+}
+
+void UserStorage::InvalidateMetadata(const fs::path& drive_path) {
+  tree_index_.Invalidate(drive_path);
+  metadata_cache_->Invalidate(drive_path);
+}
+
+void UserStorage::UpdateMetadata(const fs::path& drive_path) {
+  metadata_cache_->Invalidate(drive_path);
+  DirectoryEntry entry;
+  boost::system::error_code error_code;
+  // Patching the parent's listing in place avoids re-reading a possibly huge directory.
+  if (tree_index_.Contains(drive_path.parent_path()) &&
+      ReadDirectoryEntry(owner_path() / drive_path, &entry, error_code)) {
+    tree_index_.Upsert(drive_path, entry);
+  } else {
+    tree_index_.Invalidate(drive_path);
+  }
+}
+
+void UserStorage::OnDataMapReplaced(const std::string& replaced_data_map,
+                                    const std::string& serialised_data_map) {
+  if (replaced_data_map.empty() || replaced_data_map == serialised_data_map)
+    return;
+  content_index_->RemoveDataMap(replaced_data_map);
+  std::set<std::string> kept_chunks;
+  AddChunkNames(serialised_data_map, &kept_chunks);
+  std::vector<encrypt::ChunkDetails> replaced_chunks;
+  for (auto& chunk : ParseDataMap(replaced_data_map)->chunks) {
+    if (kept_chunks.count(chunk.hash) == 0)
+      replaced_chunks.push_back(chunk);
+  }
+  chunk_uploader_->ForgetStored(replaced_chunks);
+}
+
+void UserStorage::PostBackgroundTask(const std::string& name, const std::function<void()>& task) {
+  background_tasks_.Post([name, task] {
+                           try {
+                             task();
+                           }
+                           catch(const std::exception& e) {
+                             LOG(kWarning) << name << " failed: " << e.what();
+                           }
+                         });
+}
+
+void UserStorage::ReconcileTreeIndex() {
+  std::vector<fs::path> pending(1, fs::path());
+  size_t reconciled(0);
+  while (!pending.empty() && !stop_background_tasks_) {
+    fs::path directory(pending.back());
+    pending.pop_back();
+    std::vector<DirectoryEntry> entries;
+    try {
+      entries = ReadAndIndexDirectory(directory);
+    }
+    catch(const std::exception& e) {
+      LOG(kWarning) << "Skipping " << directory << " during reconciliation: " << e.what();
+      continue;
+    }
+    ++reconciled;
+    for (auto& entry : entries) {
+      if (entry.is_directory)
+        pending.push_back(directory / entry.name);
+    }
+  }
+  LOG(kInfo) << "Reconciled " << reconciled << " directories of the tree index"
+             << (stop_background_tasks_ ? " before stopping." : ".");
+}
+
+void UserStorage::ReplayOfflineChanges() {
+  uint64_t sequence(0);
+  std::vector<OfflineJournal::Entry> entries(offline_journal_->entries(&sequence));
+  if (entries.empty())
+    return;
+  // Only the last version journalled for each path needs storing, and only if the path still
+  // holds it.  If not, the path has been changed since, and that change takes precedence.
+  std::map<fs::path, std::string> latest;
+  std::set<std::string> superseded_chunks, current_chunks;
+  size_t conflicts(0);
+  try {
+    for (auto& entry : entries) {
+      if (entry.type != OfflineJournal::Entry::Type::kChange)
+        continue;
+      auto inserted(latest.insert(std::make_pair(entry.drive_path, entry.serialised_data_map)));
+      if (!inserted.second) {
+        AddChunkNames(inserted.first->second, &superseded_chunks);
+        inserted.first->second = entry.serialised_data_map;
+      }
+    }
+    for (auto& change : latest) {
+      std::string serialised_data_map;
+      boost::system::error_code error_code;
+      if (fs::exists(owner_path() / change.first, error_code))
+        serialised_data_map = GetDataMap(change.first);
+      AddChunkNames(serialised_data_map, &current_chunks);
+      if (serialised_data_map != change.second) {
+        ++conflicts;
+        LOG(kWarning) << change.first << " has changed since it was written offline; keeping the "
+                      << "newer version.";
+        AddChunkNames(change.second, &superseded_chunks);
+      }
+    }
+  }
+  catch(const std::exception& e) {
+    // Without a full picture, no chunk can safely be treated as superseded.
+    LOG(kWarning) << "Failed to check offline changes for conflicts: " << e.what();
+    superseded_chunks.clear();
+  }
+  if (!chunk_uploader_->Replay(entries, [&](const std::string& chunk_name) {
+                                 return superseded_chunks.count(chunk_name) == 0 ||
+                                        current_chunks.count(chunk_name) != 0;
+                               })) {
+    LOG(kInfo) << "Network unavailable again; offline changes will be replayed when it returns.";
+    return;
+  }
+  std::shared_ptr<OfflineJournal> offline_journal(offline_journal_);
+  chunk_uploader_->OnUploadsConfirmed([offline_journal, sequence] {
+    offline_journal->Discard(sequence);
+  });
+  LOG(kInfo) << "Replayed " << entries.size() << " offline changes, " << latest.size()
+             << " files changed, " << conflicts << " since superseded.";
+}
+
+std::vector<fs::path> UserStorage::PinnedFiles(const fs::path& drive_path) {
+  fs::path absolute_path(owner_path() / drive_path);
+  std::vector<fs::path> file_paths;
+  if (fs::is_directory(absolute_path)) {
+    fs::recursive_directory_iterator itr(absolute_path), end;
+    for (; itr != end; ++itr) {
+      if (fs::is_regular_file(itr->symlink_status()))
+        file_paths.push_back(drive_path /
+                             itr->path().string().substr(absolute_path.string().size() + 1));
+    }
+  } else {
+    file_paths.push_back(drive_path);
+  }
+  return file_paths;
+}
+
+void UserStorage::RefreshPin(const fs::path& drive_path, ChunkFetcher& chunk_fetcher) {
+  std::map<fs::path, PinSet::ChunkSizes> files;
+  for (auto& file_path : PinnedFiles(drive_path))
+    files[file_path] = FetchFile(file_path, chunk_fetcher);
+  pin_set_.SetChunks(drive_path, files);
+}
+
+struct UserStorage::PinRefresh {
+  explicit PinRefresh(const fs::path& pin)
+      : drive_path(pin), listed(false), file_paths(), files() {}
+  fs::path drive_path;
+  bool listed;
+  std::vector<fs::path> file_paths;
+  std::map<fs::path, PinSet::ChunkSizes> files;
+};
+
+void UserStorage::RefreshPins() {
+  for (auto& pin : pin_set_.pins()) {
+    std::shared_ptr<PinRefresh> refresh(std::make_shared<PinRefresh>(pin));
+    PostBackgroundTask("Pin refresh", [this, refresh] { RefreshPin(refresh); });
+  }
+}
+
+void UserStorage::RefreshPin(const std::shared_ptr<PinRefresh>& refresh) {
+  // An incomplete refresh would stop protecting the chunks of files not yet reached.
+  if (stop_background_tasks_)
+    return;
+  try {
+    if (!refresh->listed) {
+      refresh->file_paths = PinnedFiles(refresh->drive_path);
+      refresh->listed = true;
+    } else {
+      fs::path file_path(refresh->file_paths[refresh->files.size()]);
+      refresh->files[file_path] = FetchFile(file_path, *pin_fetcher_);
+    }
+    if (refresh->files.size() == refresh->file_paths.size()) {
+      pin_set_.SetChunks(refresh->drive_path, refresh->files);
+      return;
+    }
+  }
+  catch(const std::exception& e) {
+    LOG(kWarning) << "Failed to refresh pinned " << refresh->drive_path << ": " << e.what();
+    return;
+  }
+  PostBackgroundTask("Pin refresh", [this, refresh] { RefreshPin(refresh); });
+}
+
+void UserStorage::RefreshPinnedFile(const fs::path& file_path) {
+  try {
+    pin_set_.SetFileChunks(file_path, FetchFile(file_path, *pin_fetcher_));
+  }
+  catch(const std::exception& e) {
+    LOG(kWarning) << "Failed to refresh pinned " << file_path << ": " << e.what();
+  }
+}
+
+struct UserStorage::ScrubState {
+  ScrubState() : itr(), drive_path(), data_map(), next_chunk(0), corrupt(0) {}
+  fs::recursive_directory_iterator itr;
+  fs::path drive_path;
+  // Null between files.
+  encrypt::DataMapPtr data_map;
+  size_t next_chunk, corrupt;
+};
+
+void UserStorage::ScrubChunkStore() {
+  chunk_scrubber_->StartPass();
+  std::shared_ptr<ScrubState> scrub(std::make_shared<ScrubState>());
+  boost::system::error_code error_code;
+  scrub->itr = fs::recursive_directory_iterator(owner_path(), error_code);
+  if (error_code) {
+    LOG(kWarning) << "Can't scrub " << owner_path() << ": " << error_code.message();
+    return;
+  }
+  ScrubChunkStore(scrub);
+}
+
+void UserStorage::ScrubChunkStore(const std::shared_ptr<ScrubState>& scrub) {
+  fs::path root(owner_path());
+  // Visiting a file counts towards the step too, so that a step over many small files is bounded.
+  size_t budget(kScrubChunksPerStep);
+  while (budget != 0) {
+    if (stop_background_tasks_)
+      return;
+    if (!scrub->data_map) {
+      --budget;
+      if (scrub->itr == fs::recursive_directory_iterator()) {
+        chunk_scrubber_->FinishPass();
+        return;
+      }
+      fs::path path(scrub->itr->path());
+      bool regular_file(fs::is_regular_file(scrub->itr->symlink_status()));
+      boost::system::error_code error_code;
+      scrub->itr.increment(error_code);
+      if (error_code) {
+        LOG(kWarning) << "Scrub of " << root << " stopped early: " << error_code.message();
+        return;
+      }
+      if (!regular_file)
+        continue;
+      scrub->drive_path = path.string().substr(root.string().size() + 1);
+      try {
+        std::string serialised_data_map(GetDataMap(scrub->drive_path));
+        if (!serialised_data_map.empty())
+          scrub->data_map = ParseDataMap(serialised_data_map);
+      }
+      catch(const std::exception& e) {
+        LOG(kWarning) << "Skipping " << scrub->drive_path << " while scrubbing: " << e.what();
+      }
+      scrub->next_chunk = 0;
+      scrub->corrupt = 0;
+      continue;
+    }
+    const std::vector<encrypt::ChunkDetails>& chunks(scrub->data_map->chunks);
+    size_t count(std::min(budget, chunks.size() - scrub->next_chunk));
+    budget -= count;
+    auto begin(chunks.begin() + static_cast<std::ptrdiff_t>(scrub->next_chunk));
+    scrub->corrupt += chunk_scrubber_->Check(
+        std::vector<encrypt::ChunkDetails>(begin, begin + static_cast<std::ptrdiff_t>(count)));
+    scrub->next_chunk += count;
+    if (scrub->next_chunk != chunks.size())
+      continue;
+    // Pinned files must stay readable without the network, so they aren't left to fetch their
+    // removed chunks when next read.
+    if (scrub->corrupt != 0 && pin_set_.IsPinned(scrub->drive_path)) {
+      bool replaced(true);
+      try {
+        pin_fetcher_->Fetch(*scrub->data_map);
+      }
+      catch(const std::exception& e) {
+        LOG(kWarning) << "Failed to replace corrupt chunks of pinned " << scrub->drive_path
+                      << ": " << e.what();
+        replaced = false;
+      }
+      chunk_scrubber_->RecordReplacements(scrub->corrupt, replaced);
+    }
+    scrub->data_map.reset();
+  }
+  PostBackgroundTask("Chunk store scrub", [this, scrub] { ScrubChunkStore(scrub); });
+}
+
+PinSet::ChunkSizes UserStorage::FetchFile(const fs::path& file_path, ChunkFetcher& chunk_fetcher) {
+  PinSet::ChunkSizes chunks;
+  std::string serialised_data_map(GetDataMap(file_path));
+  if (serialised_data_map.empty())
+    return chunks;
+  encrypt::DataMapPtr data_map(ParseDataMap(serialised_data_map));
+  chunk_fetcher.Fetch(*data_map);
+  for (auto& chunk : data_map->chunks)
+    chunks[chunk.hash] = chunk.size;
+  return chunks;
+}
+
+boost::filesystem::path UserStorage::DriveRelativePath(const fs::path& drive_path) const {
+  return fs::path("/").make_preferred() / kOwner / drive_path;
+}
+
 }  // namespace lifestuff
 }  // namespace maidsafe
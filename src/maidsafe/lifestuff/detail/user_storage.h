@@ -16,6 +16,11 @@ License.
 #ifndef MAIDSAFE_LIFESTUFF_DETAIL_USER_STORAGE_H_
 #define MAIDSAFE_LIFESTUFF_DETAIL_USER_STORAGE_H_
 
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
 #include "boost/filesystem/path.hpp"
 
 #ifdef WIN32
@@ -34,8 +39,23 @@ License.
 #include "maidsafe/nfs/nfs.h"
 
 #include "maidsafe/lifestuff/lifestuff.h"
+#include "maidsafe/lifestuff/detail/chunk_fetcher.h"
+#include "maidsafe/lifestuff/detail/chunk_scrubber.h"
+#include "maidsafe/lifestuff/detail/chunk_filter.h"
+#include "maidsafe/lifestuff/detail/chunk_uploader.h"
+#include "maidsafe/lifestuff/detail/content_index.h"
+#include "maidsafe/lifestuff/detail/metadata_cache.h"
+#include "maidsafe/lifestuff/detail/mount_profile.h"
+#include "maidsafe/lifestuff/detail/offline_journal.h"
+#include "maidsafe/lifestuff/detail/pin_set.h"
 #include "maidsafe/lifestuff/detail/session.h"
+#include "maidsafe/lifestuff/detail/shared_resources.h"
+#include "maidsafe/lifestuff/detail/space_accountant.h"
+#include "maidsafe/lifestuff/detail/task_group.h"
+#include "maidsafe/lifestuff/detail/tree_index.h"
+#include "maidsafe/lifestuff/detail/upload_journal.h"
 #include "maidsafe/lifestuff/detail/utils.h"
+#include "maidsafe/lifestuff/detail/write_back_flusher.h"
 
 
 namespace maidsafe {
@@ -59,15 +79,127 @@ class UserStorage {
   typedef std::unique_ptr<PermanentStore> PermanentStorePtr;
   typedef passport::Maid Maid;
 
-  explicit UserStorage();
-  ~UserStorage() {}
+  explicit UserStorage(const OperationsPendingFunction& operations_pending);
+  ~UserStorage();
 
-  void MountDrive(ClientNfs& client_nfs, Session& session);
+  // 'profile' applies until the drive is unmounted; see MountProfile.  Its durability mode decides
+  // when ImportDirectory, ImportFile, AppendToFile and Sync return.
+  void MountDrive(ClientNfs& client_nfs,
+                  Session& session,
+                  const MountProfile& profile = MountProfile());
+  // Stops background work on the drive and returns without waiting for it to be unmounted; the
+  // drive stays mounted until a background flusher, which reports progress via
+  // Slots::operations_pending, has drained its pending uploads and unmounted it.
   void UnMountDrive(Session& session);
+  // Blocks until all flushes handed off by UnMountDrive have completed, then sets the space
+  // figures they recorded in 'session'.  Must be called before the session's space figures are
+  // read or the session is serialised.
+  void WaitForPendingFlush(Session& session);
+
+  // Copies the contents of the local directory 'local_path' into 'drive_path', which is relative
+  // to owner_path(), without routing file contents through the mounted file system.  Files with
+  // the same content as one imported before reuse its data map, skipping encryption and upload.
+  void ImportDirectory(const boost::filesystem::path& local_path,
+                       const boost::filesystem::path& drive_path,
+                       const TransferProgressFunction& progress);
+  // Copies the local file 'local_path' to 'drive_path', relative to owner_path().  Large files are
+  // encrypted on several workers and uploaded while encryption proceeds; the file appears in the
+  // drive once written, as defined by the durability mode.  If interrupted, calling again, even
+  // after a restart, skips the chunks already confirmed stored.
+  void ImportFile(const boost::filesystem::path& local_path,
+                  const boost::filesystem::path& drive_path,
+                  const TransferProgressFunction& progress);
+  // Restores the drive directory 'drive_path', relative to owner_path(), into the local directory
+  // 'local_path'.  Chunks are fetched with bounded parallelism across files.  If interrupted, a
+  // subsequent call with the same arguments resumes, skipping files already restored.
+  void ExportDirectory(const boost::filesystem::path& drive_path,
+                       const boost::filesystem::path& local_path,
+                       const TransferProgressFunction& progress);
+
+  // Returns the serialised data map of the file at 'drive_path', relative to owner_path().  The
+  // result is empty for a file with no content.
+  std::string GetDataMap(const boost::filesystem::path& drive_path);
+  // Creates or replaces the file at 'drive_path', relative to owner_path(), so that it references
+  // the chunks described by 'serialised_data_map'.  No content is encrypted or uploaded.
+  void InsertDataMap(const boost::filesystem::path& drive_path,
+                     const std::string& serialised_data_map);
+  // Copies a file by inserting its data map at the destination; cost is independent of file size.
+  void CopyFile(const boost::filesystem::path& source_path,
+                const boost::filesystem::path& destination_path);
+  // Appends 'content' to the existing file at 'drive_path', relative to owner_path().  Only the
+  // chunks the append re-encrypts are fetched, and only chunks not already part of the file are
+  // uploaded, so the cost is independent of the file's size.
+  void AppendToFile(const boost::filesystem::path& drive_path, const std::string& content);
+  // The equivalent of fsync or close for writes made through UserStorage.  Unless the durability
+  // mode is write-back, blocks until every chunk written so far is stored on the network, and
+  // throws if any failed to store.  While offline, returns once chunks are stored locally.
+  void Sync();
+
+  // Called with each change in network health reported by routing; negative means unavailable.
+  // While unavailable, writes made through UserStorage are applied to the drive and the local
+  // store as usual and recorded in a journal kept with the session's data, rather than failing.
+  // Once the network returns, or on the next mount, the journal is replayed: chunks are put in the
+  // order written, except those referenced only by journalled versions which have since been
+  // superseded, whether by a later offline write or by a change made through the mount.
+  void OnNetworkHealthChange(int network_health);
+  bool offline() const { return offline_; }
+
+  // Keeps the file or directory at 'drive_path', relative to owner_path(), available locally.
+  // Blocks until every chunk it references is in the local store.  Pins are kept between mounts,
+  // and refreshed in the background after mounting, when the network returns, and when a pinned
+  // file is replaced through UserStorage, so pinned content is read without the network.
+  void PinPath(const boost::filesystem::path& drive_path);
+  void UnpinPath(const boost::filesystem::path& drive_path);
+  std::vector<boost::filesystem::path> PinnedPaths() const;
+  // Size of the distinct chunks held locally for pinned content, before compression; zero when
+  // not mounted.
+  uint64_t pinned_space() const;
+
+  // Records the current state of the owner tree under 'name' in 'session'.  Only directory
+  // structure and data maps are captured; file contents are shared with the live drive through
+  // their chunks, so the cost depends on the number of entries rather than their size.
+  void TakeSnapshot(const std::string& name, Session& session);
+  // Recreates snapshot 'name' at 'drive_path', relative to owner_path(), referencing the same
+  // chunks as when the snapshot was taken.
+  void RestoreSnapshot(const std::string& name,
+                       const boost::filesystem::path& drive_path,
+                       Session& session);
+
+  // Lists the drive directory 'drive_path', relative to owner_path().  Listings are served from a
+  // local index of the tree, saved between mounts and refreshed in the background after mounting,
+  // and only read through the mounted file system when not yet indexed.
+  std::vector<DirectoryEntry> ListDirectory(const boost::filesystem::path& drive_path);
+  // Returns up to 'max_entries' entries of 'drive_path' in name order, starting after the entry
+  // named 'start_after'; pass the last name returned to fetch the next page.
+  std::vector<DirectoryEntry> ListDirectory(const boost::filesystem::path& drive_path,
+                                            const std::string& start_after,
+                                            size_t max_entries);
+  // Returns the attributes of 'drive_path', relative to owner_path(), using the same index as
+  // ListDirectory behind a short-lived cache which also remembers paths that don't exist.  Throws
+  // CommonErrors::no_such_element if there is no such entry.
+  DirectoryEntry GetDirectoryEntry(const boost::filesystem::path& drive_path);
 
   boost::filesystem::path mount_path();
   boost::filesystem::path owner_path();
   bool mount_status();
+  std::shared_ptr<SharedResources> shared_resources() const;
+  MountProfile mount_profile() const;
+  // Space used and allowed while mounted, kept current as chunks are stored.  Both are zero when
+  // not mounted; the session holds the figures from the last unmount.
+  int64_t used_space() const;
+  int64_t max_space() const;
+  // Estimated rate at which puts are wrongly skipped as already stored; zero when not mounted.
+  double chunk_filter_false_positive_rate() const;
+  // Puts skipped this mount because the chunk filter showed them stored by an earlier mount; zero
+  // when not mounted.
+  uint64_t chunks_filtered() const;
+  // Chunks and changes made while offline and not yet confirmed stored since the network returned;
+  // zero when not mounted.
+  size_t pending_offline_entries() const;
+  // Progress of the scrubber which, once per mount, checks in the background the local chunks of
+  // every file in the drive, removing corrupt ones and fetching replacements for pinned files.
+  // All zero when not mounted.
+  ChunkScrubber::Progress scrub_progress() const;
 
  private:
   UserStorage &operator=(const UserStorage&);
@@ -78,11 +210,87 @@ class UserStorage {
                        const NonEmptyString& content,
                        bool overwrite_existing);
 
+  // The path of the file 'name' in the session's local directory, or of the directory itself if
+  // 'name' is empty.
+  boost::filesystem::path SessionFilePath(const Session& session,
+                                          const boost::filesystem::path& name) const;
+  std::vector<DirectoryEntry> ReadDirectory(const boost::filesystem::path& drive_path);
+  bool DirectoryWriteTime(const boost::filesystem::path& drive_path, int64_t* last_write_time);
+  // Reads the listing of 'drive_path' and adds it to the tree index, stamped with the directory's
+  // last write time so that later changes made through the mounted drive are noticed.
+  std::vector<DirectoryEntry> ReadAndIndexDirectory(const boost::filesystem::path& drive_path);
+  bool ReadDirectoryEntry(const boost::filesystem::path& absolute_path,
+                          DirectoryEntry* entry,
+                          boost::system::error_code& error_code);
+  bool FindDirectoryEntry(const boost::filesystem::path& drive_path, DirectoryEntry* entry);
+  // One of these must be called for every change made to the drive through UserStorage.
+  // InvalidateMetadata suits changes to whole subtrees, UpdateMetadata changes to a single file.
+  void InvalidateMetadata(const boost::filesystem::path& drive_path);
+  void UpdateMetadata(const boost::filesystem::path& drive_path);
+  // Called for every data map replaced through UserStorage.  Chunks only the replaced version
+  // referenced may have been deleted with it, so mustn't be assumed stored when next uploaded, nor
+  // the replaced data map reused for imported content.
+  void OnDataMapReplaced(const std::string& replaced_data_map,
+                         const std::string& serialised_data_map);
+  // Posts 'task' to background_tasks_, logging rather than propagating its failure, as the group
+  // would otherwise skip every later task until the drive is unmounted.
+  void PostBackgroundTask(const std::string& name, const std::function<void()>& task);
+  void ReconcileTreeIndex();
+  // Puts again the chunks recorded in the retry journal, returning false if any still fail.
+  bool RetryFailedPuts();
+  void ReplayOfflineChanges();
+  std::vector<boost::filesystem::path> PinnedFiles(const boost::filesystem::path& drive_path);
+  // Fetches the chunks of every file under the pinned 'drive_path' using 'chunk_fetcher' and
+  // records them in the pin set.
+  void RefreshPin(const boost::filesystem::path& drive_path, ChunkFetcher& chunk_fetcher);
+  // Refreshes every pin in the background, one file per task so that a large pin doesn't hold a
+  // background thread for long.
+  struct PinRefresh;
+  void RefreshPins();
+  void RefreshPin(const std::shared_ptr<PinRefresh>& refresh);
+  void RefreshPinnedFile(const boost::filesystem::path& file_path);
+  // Starts a scrub pass, which runs as a series of background tasks each checking a few chunks.
+  struct ScrubState;
+  void ScrubChunkStore();
+  void ScrubChunkStore(const std::shared_ptr<ScrubState>& scrub);
+  PinSet::ChunkSizes FetchFile(const boost::filesystem::path& file_path,
+                               ChunkFetcher& chunk_fetcher);
+  boost::filesystem::path DriveRelativePath(const boost::filesystem::path& drive_path) const;
+
   bool mount_status_;
+  std::shared_ptr<SharedResources> shared_resources_;
+  // Declared after shared_resources_, as queued flushes still use its scheduler and bandwidth
+  // limits while the flusher's destructor drains them.
+  WriteBackFlusher flusher_;
+  MountProfile mount_profile_;
+  std::shared_ptr<SpaceAccountant> space_accountant_;
+  std::shared_ptr<ChunkFilter> chunk_filter_;
   PermanentStorePtr data_store_;
-  boost::filesystem::path mount_path_;
+  std::unique_ptr<ChunkUploader> chunk_uploader_;
+  std::unique_ptr<ChunkFetcher> chunk_fetcher_, pin_fetcher_;
+  std::unique_ptr<ChunkScrubber> chunk_scrubber_;
+  boost::filesystem::path mount_path_, upload_journals_path_, retry_journal_path_;
   std::unique_ptr<MaidDrive> drive_;
   std::thread mount_thread_;
+  std::mutex drive_mutex_;
+  TreeIndex tree_index_;
+  std::shared_ptr<ContentIndex> content_index_;
+  std::unique_ptr<MetadataCache> metadata_cache_;
+  std::shared_ptr<OfflineJournal> offline_journal_;
+  std::shared_ptr<UploadJournal> retry_journal_;
+  PinSet pin_set_;
+  std::atomic<bool> stop_background_tasks_, offline_;
+  std::mutex network_mutex_;
+  TaskGroup background_tasks_;
+  // Written by flushes on the flusher's thread and only applied to the session by
+  // WaitForPendingFlush, so that the session is never modified concurrently.
+  struct FlushedSpace {
+    FlushedSpace() : mutex(), recorded(false), max_space(0), used_space(0) {}
+    std::mutex mutex;
+    bool recorded;
+    int64_t max_space, used_space;
+  };
+  std::shared_ptr<FlushedSpace> flushed_space_;
 };
 
 }  // namespace lifestuff
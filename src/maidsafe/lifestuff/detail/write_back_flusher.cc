@@ -0,0 +1,131 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#include "maidsafe/lifestuff/detail/write_back_flusher.h"
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+namespace lifestuff {
+
+WriteBackFlusher::WriteBackFlusher(const OperationsPendingFunction& operations_pending)
+    : operations_pending_(operations_pending),
+      operations_(),
+      running_(),
+      running_flush_(false),
+      stopped_(false),
+      mutex_(),
+      condition_variable_(),
+      worker_() {
+  worker_ = std::move(std::thread([this] { Run(); }));
+}
+
+WriteBackFlusher::~WriteBackFlusher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  condition_variable_.notify_all();
+  worker_.join();
+}
+
+void WriteBackFlusher::Enqueue(const fs::path& journal_path,
+                               const std::string& description,
+                               const FlushFunctor& flush) {
+  if (!WriteFile(journal_path, description))
+    LOG(kWarning) << "Failed to write flush journal " << journal_path;
+  bool was_idle(false);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    was_idle = operations_.empty() && !running_flush_;
+    operations_.push_back(std::make_pair(journal_path, flush));
+  }
+  if (was_idle)
+    SetPending(true);
+  condition_variable_.notify_all();
+}
+
+void WriteBackFlusher::WaitUntilFlushed() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_variable_.wait(lock, [this] { return operations_.empty() && !running_flush_; });
+}
+
+bool WriteBackFlusher::pending() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !operations_.empty() || running_flush_;
+}
+
+bool WriteBackFlusher::Interrupted(const fs::path& journal_path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_flush_ && running_ == journal_path)
+      return false;
+    for (auto& operation : operations_) {
+      if (operation.first == journal_path)
+        return false;
+    }
+  }
+  boost::system::error_code error_code;
+  return fs::exists(journal_path, error_code);
+}
+
+void WriteBackFlusher::Run() {
+  for (;;) {
+    Operation operation;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_variable_.wait(lock, [this] { return stopped_ || !operations_.empty(); });
+      // Queued flushes are always drained, even when stopping, so that no pending data is lost.
+      if (operations_.empty())
+        return;
+      operation = operations_.front();
+      operations_.pop_front();
+      running_ = operation.first;
+      running_flush_ = true;
+    }
+    try {
+      operation.second();
+      boost::system::error_code error_code;
+      fs::remove(operation.first, error_code);
+    }
+    catch(const std::exception& e) {
+      // The journal is left in place so that the failure is reported on the next mount.
+      LOG(kError) << "Flush for " << operation.first << " failed: " << e.what();
+    }
+    bool drained(false);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_.clear();
+      running_flush_ = false;
+      drained = operations_.empty();
+    }
+    if (drained)
+      SetPending(false);
+    condition_variable_.notify_all();
+  }
+}
+
+void WriteBackFlusher::SetPending(bool pending) {
+  if (operations_pending_)
+    operations_pending_(pending);
+}
+
+}  // namespace lifestuff
+}  // namespace maidsafe
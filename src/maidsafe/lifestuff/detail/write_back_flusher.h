@@ -0,0 +1,79 @@
+/* Copyright 2013 MaidSafe.net limited
+
+This MaidSafe Software is licensed under the MaidSafe.net Commercial License, version 1.0 or later,
+and The General Public License (GPL), version 3. By contributing code to this project You agree to
+the terms laid out in the MaidSafe Contributor Agreement, version 1.0, found in the root directory
+of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also available at:
+
+http://www.novinet.com/license
+
+Unless required by applicable law or agreed to in writing, software distributed under the License is
+distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+implied. See the License for the specific language governing permissions and limitations under the
+License.
+*/
+
+#ifndef MAIDSAFE_LIFESTUFF_DETAIL_WRITE_BACK_FLUSHER_H_
+#define MAIDSAFE_LIFESTUFF_DETAIL_WRITE_BACK_FLUSHER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/lifestuff/lifestuff.h"
+
+namespace maidsafe {
+namespace lifestuff {
+
+// Runs flush operations (e.g. unmounting a drive and draining its pending uploads) in order on a
+// single background thread.  Each operation is recorded in a journal file for as long as it is
+// outstanding, so an interrupted flush is visible on the next start.  'operations_pending' is
+// called with true when the queue becomes non-empty and with false once it has fully drained.
+class WriteBackFlusher {
+ public:
+  typedef std::function<void()> FlushFunctor;
+
+  explicit WriteBackFlusher(const OperationsPendingFunction& operations_pending);
+  ~WriteBackFlusher();
+
+  // Writes 'description' to 'journal_path' then queues 'flush'.  The journal file is removed once
+  // 'flush' has returned.
+  void Enqueue(const boost::filesystem::path& journal_path,
+               const std::string& description,
+               const FlushFunctor& flush);
+  // Blocks until all queued flushes have completed.
+  void WaitUntilFlushed();
+  bool pending();
+
+  // Returns true if 'journal_path' exists and is not owned by a queued or running flush, i.e. a
+  // previous process was stopped before its flush completed.
+  bool Interrupted(const boost::filesystem::path& journal_path);
+
+ private:
+  WriteBackFlusher(const WriteBackFlusher&);
+  WriteBackFlusher& operator=(const WriteBackFlusher&);
+
+  typedef std::pair<boost::filesystem::path, FlushFunctor> Operation;
+
+  void Run();
+  void SetPending(bool pending);
+
+  OperationsPendingFunction operations_pending_;
+  std::deque<Operation> operations_;
+  boost::filesystem::path running_;
+  bool running_flush_, stopped_;
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  std::thread worker_;
+};
+
+}  // namespace lifestuff
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_LIFESTUFF_DETAIL_WRITE_BACK_FLUSHER_H_
@@ -15,6 +15,8 @@ License.
 
 #include "maidsafe/lifestuff/lifestuff_api.h"
 
+#include <limits>
+
 #include "maidsafe/lifestuff/lifestuff_impl.h"
 
 namespace maidsafe {
@@ -61,6 +63,87 @@ void LifeStuff::UnMountDrive() {
   return lifestuff_impl_->UnMountDrive();
 }
 
+void LifeStuff::ImportDirectory(const std::string& local_path,
+                                const std::string& drive_path,
+                                const TransferProgressFunction& progress) {
+  return lifestuff_impl_->ImportDirectory(local_path, drive_path, progress);
+}
+
+void LifeStuff::ImportFile(const std::string& local_path,
+                           const std::string& drive_path,
+                           const TransferProgressFunction& progress) {
+  return lifestuff_impl_->ImportFile(local_path, drive_path, progress);
+}
+
+void LifeStuff::ExportDirectory(const std::string& drive_path,
+                                const std::string& local_path,
+                                const TransferProgressFunction& progress) {
+  return lifestuff_impl_->ExportDirectory(drive_path, local_path, progress);
+}
+
+void LifeStuff::CopyFile(const std::string& source_path, const std::string& destination_path) {
+  return lifestuff_impl_->CopyFile(source_path, destination_path);
+}
+
+void LifeStuff::AppendToFile(const std::string& drive_path, const std::string& content) {
+  return lifestuff_impl_->AppendToFile(drive_path, content);
+}
+
+void LifeStuff::TakeSnapshot(const std::string& name) {
+  return lifestuff_impl_->TakeSnapshot(name);
+}
+
+void LifeStuff::RestoreSnapshot(const std::string& name, const std::string& drive_path) {
+  return lifestuff_impl_->RestoreSnapshot(name, drive_path);
+}
+
+void LifeStuff::DeleteSnapshot(const std::string& name) {
+  return lifestuff_impl_->DeleteSnapshot(name);
+}
+
+std::vector<std::string> LifeStuff::ListSnapshots() const {
+  return lifestuff_impl_->ListSnapshots();
+}
+
+std::vector<DirectoryEntry> LifeStuff::ListDirectory(const std::string& drive_path) {
+  return lifestuff_impl_->ListDirectory(drive_path, "", std::numeric_limits<size_t>::max());
+}
+
+std::vector<DirectoryEntry> LifeStuff::ListDirectory(const std::string& drive_path,
+                                                     const std::string& start_after,
+                                                     size_t max_entries) {
+  return lifestuff_impl_->ListDirectory(drive_path, start_after, max_entries);
+}
+
+int64_t LifeStuff::used_space() {
+  return lifestuff_impl_->used_space();
+}
+
+int64_t LifeStuff::max_space() {
+  return lifestuff_impl_->max_space();
+}
+
+void LifeStuff::SetBandwidthLimits(uint64_t upload_bytes_per_second,
+                                   uint64_t download_bytes_per_second) {
+  return lifestuff_impl_->SetBandwidthLimits(upload_bytes_per_second, download_bytes_per_second);
+}
+
+void LifeStuff::PinPath(const std::string& drive_path) {
+  return lifestuff_impl_->PinPath(drive_path);
+}
+
+void LifeStuff::UnpinPath(const std::string& drive_path) {
+  return lifestuff_impl_->UnpinPath(drive_path);
+}
+
+std::vector<std::string> LifeStuff::PinnedPaths() {
+  return lifestuff_impl_->PinnedPaths();
+}
+
+uint64_t LifeStuff::pinned_space() {
+  return lifestuff_impl_->pinned_space();
+}
+
 void LifeStuff::ChangeKeyword() {
   return lifestuff_impl_->ChangeKeyword();
 }
@@ -187,6 +187,87 @@ void LifeStuffImpl::UnMountDrive() {
   client_maid_.UnMountDrive();
 }
 
+void LifeStuffImpl::ImportDirectory(const boost::filesystem::path& local_path,
+                                    const boost::filesystem::path& drive_path,
+                                    const TransferProgressFunction& progress) {
+  client_maid_.ImportDirectory(local_path, drive_path, progress);
+}
+
+void LifeStuffImpl::ImportFile(const boost::filesystem::path& local_path,
+                               const boost::filesystem::path& drive_path,
+                               const TransferProgressFunction& progress) {
+  client_maid_.ImportFile(local_path, drive_path, progress);
+}
+
+void LifeStuffImpl::ExportDirectory(const boost::filesystem::path& drive_path,
+                                    const boost::filesystem::path& local_path,
+                                    const TransferProgressFunction& progress) {
+  client_maid_.ExportDirectory(drive_path, local_path, progress);
+}
+
+void LifeStuffImpl::CopyFile(const boost::filesystem::path& source_path,
+                             const boost::filesystem::path& destination_path) {
+  client_maid_.CopyFile(source_path, destination_path);
+}
+
+void LifeStuffImpl::AppendToFile(const boost::filesystem::path& drive_path,
+                                 const std::string& content) {
+  client_maid_.AppendToFile(drive_path, content);
+}
+
+void LifeStuffImpl::TakeSnapshot(const std::string& name) {
+  client_maid_.TakeSnapshot(name);
+}
+
+void LifeStuffImpl::RestoreSnapshot(const std::string& name,
+                                    const boost::filesystem::path& drive_path) {
+  client_maid_.RestoreSnapshot(name, drive_path);
+}
+
+void LifeStuffImpl::DeleteSnapshot(const std::string& name) {
+  client_maid_.DeleteSnapshot(name);
+}
+
+std::vector<std::string> LifeStuffImpl::ListSnapshots() const {
+  return client_maid_.ListSnapshots();
+}
+
+std::vector<DirectoryEntry> LifeStuffImpl::ListDirectory(
+    const boost::filesystem::path& drive_path,
+    const std::string& start_after,
+    size_t max_entries) {
+  return client_maid_.ListDirectory(drive_path, start_after, max_entries);
+}
+
+int64_t LifeStuffImpl::used_space() {
+  return client_maid_.used_space();
+}
+
+int64_t LifeStuffImpl::max_space() {
+  return client_maid_.max_space();
+}
+
+void LifeStuffImpl::SetBandwidthLimits(uint64_t upload_bytes_per_second,
+                                       uint64_t download_bytes_per_second) {
+  client_maid_.SetBandwidthLimits(upload_bytes_per_second, download_bytes_per_second);
+}
+
+void LifeStuffImpl::PinPath(const boost::filesystem::path& drive_path) {
+  client_maid_.PinPath(drive_path);
+}
+
+void LifeStuffImpl::UnpinPath(const boost::filesystem::path& drive_path) {
+  client_maid_.UnpinPath(drive_path);
+}
+
+std::vector<std::string> LifeStuffImpl::PinnedPaths() {
+  return client_maid_.PinnedPaths();
+}
+
+uint64_t LifeStuffImpl::pinned_space() {
+  return client_maid_.pinned_space();
+}
+
 void LifeStuffImpl::ChangeKeyword() {
   if (!ConfirmUserInput(kCurrentPassword))
     ThrowError(CommonErrors::invalid_parameter);
@@ -40,6 +40,32 @@ class LifeStuffImpl {
   void LogOut();
   void MountDrive();
   void UnMountDrive();
+  void ImportDirectory(const boost::filesystem::path& local_path,
+                       const boost::filesystem::path& drive_path,
+                       const TransferProgressFunction& progress);
+  void ImportFile(const boost::filesystem::path& local_path,
+                  const boost::filesystem::path& drive_path,
+                  const TransferProgressFunction& progress);
+  void ExportDirectory(const boost::filesystem::path& drive_path,
+                       const boost::filesystem::path& local_path,
+                       const TransferProgressFunction& progress);
+  void CopyFile(const boost::filesystem::path& source_path,
+                const boost::filesystem::path& destination_path);
+  void AppendToFile(const boost::filesystem::path& drive_path, const std::string& content);
+  void TakeSnapshot(const std::string& name);
+  void RestoreSnapshot(const std::string& name, const boost::filesystem::path& drive_path);
+  void DeleteSnapshot(const std::string& name);
+  std::vector<std::string> ListSnapshots() const;
+  std::vector<DirectoryEntry> ListDirectory(const boost::filesystem::path& drive_path,
+                                            const std::string& start_after,
+                                            size_t max_entries);
+  int64_t used_space();
+  int64_t max_space();
+  void SetBandwidthLimits(uint64_t upload_bytes_per_second, uint64_t download_bytes_per_second);
+  void PinPath(const boost::filesystem::path& drive_path);
+  void UnpinPath(const boost::filesystem::path& drive_path);
+  std::vector<std::string> PinnedPaths();
+  uint64_t pinned_space();
 
   void ChangeKeyword();
   void ChangePin();
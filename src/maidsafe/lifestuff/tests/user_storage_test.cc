@@ -13,18 +13,45 @@ implied. See the License for the specific language governing permissions and lim
 License.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/crypto.h"
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/data_types/immutable_data.h"
+
 #include "maidsafe/nfs/nfs.h"
 
+#include "maidsafe/lifestuff/detail/chunk_filter.h"
+#include "maidsafe/lifestuff/detail/chunk_scrubber.h"
+#include "maidsafe/lifestuff/detail/content_index.h"
+#include "maidsafe/lifestuff/detail/directory_exporter.h"
+#include "maidsafe/lifestuff/detail/file_encryptor.h"
+#include "maidsafe/lifestuff/detail/metadata_cache.h"
+#include "maidsafe/lifestuff/detail/nfs_scheduler.h"
+#include "maidsafe/lifestuff/detail/offline_journal.h"
+#include "maidsafe/lifestuff/detail/pin_set.h"
 #include "maidsafe/lifestuff/detail/routing_handler.h"
 #include "maidsafe/lifestuff/detail/session.h"
+#include "maidsafe/lifestuff/detail/shared_resources.h"
+#include "maidsafe/lifestuff/detail/space_accountant.h"
+#include "maidsafe/lifestuff/detail/task_group.h"
+#include "maidsafe/lifestuff/detail/token_bucket.h"
+#include "maidsafe/lifestuff/detail/tree_index.h"
+#include "maidsafe/lifestuff/detail/upload_journal.h"
 #include "maidsafe/lifestuff/detail/user_storage.h"
 #include "maidsafe/lifestuff/tests/test_utils.h"
 
@@ -58,9 +85,9 @@ class UserStorageTest : public testing::Test {
         LOG(kInfo) << "Public key requested.";
       });
     passport::Maid maid(session_.passport().Get<passport::Maid>(true));
-    routing_handler_.reset(new RoutingHandler(maid, public_key_request));
+    routing_handler_.reset(new RoutingHandler(maid, public_key_request, [](int32_t) {}));
     client_nfs_.reset(new nfs::ClientMaidNfs(routing_handler_->routing(), maid));
-    user_storage_.reset(new UserStorage());
+    user_storage_.reset(new UserStorage([](bool) {}));
   }
 
   void TearDown() {}
@@ -78,6 +105,39 @@ class UserStorageTest : public testing::Test {
     return user_storage_->owner_path();
   }
 
+  // A local tree made by CreateTestTree, with each file's path relative to 'root'.
+  struct TestFile {
+    TestFile(const fs::path& local_path_in, const fs::path& relative_path_in)
+        : local_path(local_path_in),
+          relative_path(relative_path_in) {}
+    fs::path local_path, relative_path;
+  };
+  struct TestTree {
+    TestTree() : root(), files(), total_size(0) {}
+    fs::path root;
+    std::vector<TestFile> files;
+    uint32_t total_size;
+  };
+
+  TestTree CreateTestTree(uint32_t directory_node_count = 20, uint32_t file_node_count = 100) {
+    std::vector<fs::path> directories;
+    std::set<fs::path> files;
+    TestTree tree;
+    tree.total_size = CreateTestTreeStructure(*test_dir_, &directories, &files,
+                                              directory_node_count, file_node_count);
+    tree.root = directories.front();
+    for (auto& file : files)
+      tree.files.push_back(TestFile(file, file.string().substr(tree.root.string().size() + 1)));
+    return tree;
+  }
+
+  // Creates a test tree and imports it to 'drive_path' on the mounted drive.
+  TestTree ImportTestTree(const fs::path& drive_path) {
+    TestTree tree(CreateTestTree());
+    EXPECT_NO_THROW(user_storage_->ImportDirectory(tree.root, drive_path, nullptr));
+    return tree;
+  }
+
   maidsafe::test::TestPath test_dir_;
   fs::path mount_dir_;
   Session session_;
@@ -87,6 +147,591 @@ class UserStorageTest : public testing::Test {
 };
 
 
+TEST_F(UserStorageTest, BEH_SharedResourcesInterleaveTaskGroups) {
+  std::shared_ptr<SharedResources> resources(SharedResources::Get());
+  EXPECT_EQ(resources, SharedResources::Get());
+  EXPECT_EQ(resources, user_storage_->shared_resources());
+
+  // Routing callbacks and background maintenance must still run while bulk work holds every
+  // shared worker.
+  {
+    std::mutex mutex;
+    std::condition_variable condition_variable;
+    bool released(false);
+    TaskGroup bulk(resources->io_service()), routing(resources->routing_io_service()),
+              background(resources->background_io_service());
+    for (uint32_t i(0); i != resources->worker_count(); ++i) {
+      bulk.Post([&] {
+                  std::unique_lock<std::mutex> lock(mutex);
+                  condition_variable.wait(lock, [&released] { return released; });
+                });
+    }
+    std::promise<void> callback_run, maintenance_run;
+    routing.Post([&callback_run] { callback_run.set_value(); });
+    background.Post([&maintenance_run] { maintenance_run.set_value(); });
+    EXPECT_EQ(std::future_status::ready,
+              callback_run.get_future().wait_for(std::chrono::seconds(10)));
+    EXPECT_EQ(std::future_status::ready,
+              maintenance_run.get_future().wait_for(std::chrono::seconds(10)));
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      released = true;
+    }
+    condition_variable.notify_all();
+    bulk.Wait();
+    routing.Wait();
+    background.Wait();
+  }
+
+  // On a single thread, a group posted after a large one must not wait for it to drain.
+  AsioService asio_service(1);
+  std::vector<char> order;
+  {
+    TaskGroup bulk(asio_service.service(), 2), interactive(asio_service.service(), 2);
+    for (int i(0); i != 100; ++i)
+      bulk.Post([&order] { order.push_back('b'); });
+    for (int i(0); i != 10; ++i)
+      interactive.Post([&order] { order.push_back('i'); });
+    asio_service.Start();
+    bulk.Wait();
+    interactive.Wait();
+  }
+  asio_service.Stop();
+  ASSERT_EQ(110U, order.size());
+  EXPECT_LT(std::find(order.begin(), order.end(), 'i') - order.begin(), 4);
+  EXPECT_LT(std::find(order.rbegin(), order.rend(), 'i').base() - order.begin(), 30);
+}
+
+TEST_F(UserStorageTest, BEH_TreeIndexInvalidationAndPersistence) {
+  auto make_entry = [](const std::string& name, bool is_directory)->DirectoryEntry {
+    DirectoryEntry entry;
+    entry.name = name;
+    entry.is_directory = is_directory;
+    return entry;
+  };
+  TreeIndex index;
+  std::vector<DirectoryEntry> entries;
+  const int64_t kWriteTime(1000);
+  EXPECT_FALSE(index.List(fs::path(), kWriteTime, &entries));
+  index.Replace(fs::path(), std::vector<DirectoryEntry>(1, make_entry("a", true)), kWriteTime,
+                index.generation());
+  index.Replace(fs::path("a"), std::vector<DirectoryEntry>(1, make_entry("b", true)), kWriteTime,
+                index.generation());
+  index.Replace(fs::path("a/b"), std::vector<DirectoryEntry>(1, make_entry("c", false)),
+                kWriteTime, index.generation());
+  EXPECT_EQ(3U, index.directory_count());
+  DirectoryEntry entry;
+  EXPECT_EQ(TreeIndex::Result::kFound, index.Find(fs::path("a/b/c"), kWriteTime, &entry));
+  EXPECT_FALSE(entry.is_directory);
+  EXPECT_EQ(TreeIndex::Result::kNotFound, index.Find(fs::path("a/b/d"), kWriteTime, &entry));
+
+  // A listing whose directory has since been written, e.g. through the mounted drive, is stale.
+  EXPECT_FALSE(index.List(fs::path("a/b"), kWriteTime + 1, &entries));
+  EXPECT_EQ(TreeIndex::Result::kMiss, index.Find(fs::path("a/b/d"), kWriteTime + 1, &entry));
+
+  // A listing read before an invalidation must not be applied after it.
+  uint64_t generation(index.generation());
+  index.Invalidate(fs::path("a/b/c"));
+  EXPECT_FALSE(index.List(fs::path("a/b"), kWriteTime, &entries));
+  index.Replace(fs::path("a/b"), std::vector<DirectoryEntry>(), kWriteTime, generation);
+  EXPECT_FALSE(index.List(fs::path("a/b"), kWriteTime, &entries));
+
+  // Dropping a directory from its parent's listing drops its subtree.
+  index.Replace(fs::path("a/b"), std::vector<DirectoryEntry>(1, make_entry("c", false)),
+                kWriteTime, index.generation());
+  index.Replace(fs::path(), std::vector<DirectoryEntry>(), kWriteTime, index.generation());
+  EXPECT_EQ(1U, index.directory_count());
+
+  // Upserts patch a held listing in place and keep it ordered for paging.
+  index.Replace(fs::path(), std::vector<DirectoryEntry>(1, make_entry("m", false)), kWriteTime,
+                index.generation());
+  index.Upsert(fs::path("z"), make_entry("z", false));
+  index.Upsert(fs::path("a"), make_entry("a", true));
+  index.Upsert(fs::path("a/unheld"), make_entry("unheld", false));
+  EXPECT_FALSE(index.Contains(fs::path("a")));
+  EXPECT_TRUE(index.List(fs::path(), kWriteTime, "", 2, &entries));
+  ASSERT_EQ(2U, entries.size());
+  EXPECT_EQ("a", entries[0].name);
+  EXPECT_EQ("m", entries[1].name);
+  EXPECT_TRUE(index.List(fs::path(), kWriteTime, entries[1].name, 2, &entries));
+  ASSERT_EQ(1U, entries.size());
+  EXPECT_EQ("z", entries[0].name);
+  EXPECT_TRUE(index.List(fs::path(), kWriteTime, "z", 2, &entries));
+  EXPECT_TRUE(entries.empty());
+
+  // Each save is encrypted with a fresh IV.
+  fs::path index_path(*test_dir_ / "tree.index");
+  index.Save(index_path, session_.unique_user_id());
+  NonEmptyString first_save(ReadFile(index_path));
+  index.Save(index_path, session_.unique_user_id());
+  EXPECT_FALSE(first_save == ReadFile(index_path));
+  TreeIndex loaded_index;
+  EXPECT_FALSE(loaded_index.Load(index_path, Identity(RandomAlphaNumericString(64))));
+  EXPECT_TRUE(loaded_index.Load(index_path, session_.unique_user_id()));
+  EXPECT_EQ(TreeIndex::Result::kFound, loaded_index.Find(fs::path("a"), kWriteTime, &entry));
+  EXPECT_TRUE(entry.is_directory);
+}
+
+TEST_F(UserStorageTest, BEH_MetadataCacheExpiryAndInvalidation) {
+  MetadataCache cache(std::chrono::milliseconds(100), std::chrono::milliseconds(200), 4);
+  DirectoryEntry entry;
+  entry.name = "file";
+  entry.size = 10;
+  EXPECT_EQ(MetadataCache::Result::kMiss, cache.Get(fs::path("a/file"), &entry));
+  cache.Put(fs::path("a/file"), entry);
+  cache.PutNotFound(fs::path("b"));
+  cache.PutNotFound(fs::path("a/file/.git"));
+  DirectoryEntry found;
+  EXPECT_EQ(MetadataCache::Result::kFound, cache.Get(fs::path("a/file"), &found));
+  EXPECT_EQ(10U, found.size);
+  EXPECT_EQ(MetadataCache::Result::kNotFound, cache.Get(fs::path("b"), &found));
+
+  // Creating "b/c" creates "b", so the not-found entry for "b" must go.
+  cache.Invalidate(fs::path("b/c"));
+  EXPECT_EQ(MetadataCache::Result::kMiss, cache.Get(fs::path("b"), &found));
+  cache.Invalidate(fs::path("a/file"));
+  EXPECT_EQ(MetadataCache::Result::kMiss, cache.Get(fs::path("a/file/.git"), &found));
+
+  cache.Put(fs::path("a/file"), entry);
+  cache.PutNotFound(fs::path("b"));
+  Sleep(bptime::milliseconds(150));
+  EXPECT_EQ(MetadataCache::Result::kMiss, cache.Get(fs::path("a/file"), &found));
+  EXPECT_EQ(MetadataCache::Result::kNotFound, cache.Get(fs::path("b"), &found));
+  Sleep(bptime::milliseconds(100));
+  EXPECT_EQ(MetadataCache::Result::kMiss, cache.Get(fs::path("b"), &found));
+}
+
+TEST_F(UserStorageTest, BEH_SpaceAccountantNeverExceedsLimit) {
+  SpaceAccountant accountant(1000, 100);
+  EXPECT_EQ(900, accountant.available_space());
+  std::atomic<int> reserved(0);
+  std::vector<std::thread> threads;
+  for (int i(0); i != 8; ++i) {
+    threads.push_back(std::thread([&] {
+                                    for (int j(0); j != 100; ++j) {
+                                      if (accountant.Reserve(7))
+                                        ++reserved;
+                                    }
+                                  }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(900 / 7, reserved);
+  EXPECT_EQ(100 + reserved * 7, accountant.used_space());
+  EXPECT_FALSE(accountant.Reserve(7));
+  accountant.Release(7);
+  EXPECT_TRUE(accountant.Reserve(7));
+}
+
+TEST_F(UserStorageTest, BEH_UploadJournalResumesAfterInterruption) {
+  fs::path journal_path(*test_dir_ / "uploads" / "journal");
+  std::vector<std::string> chunk_names;
+  for (int i(0); i != 10; ++i)
+    chunk_names.push_back(RandomString(64));
+  {
+    UploadJournal journal(journal_path);
+    EXPECT_EQ(0U, journal.resumed_count());
+    for (int i(0); i != 5; ++i)
+      journal.Record(chunk_names[i]);
+    journal.Record(chunk_names[0]);
+  }
+  // Simulate a crash part way through appending an entry.
+  {
+    fs::ofstream append(journal_path, std::ios_base::out | std::ios_base::app);
+    append << EncodeToHex(chunk_names[5]).substr(0, 17);
+  }
+  {
+    UploadJournal journal(journal_path);
+    EXPECT_EQ(5U, journal.resumed_count());
+    for (int i(0); i != 5; ++i)
+      EXPECT_TRUE(journal.Contains(chunk_names[i]));
+    for (int i(5); i != 10; ++i)
+      EXPECT_FALSE(journal.Contains(chunk_names[i]));
+    journal.Record(chunk_names[9]);
+  }
+  UploadJournal journal(journal_path);
+  EXPECT_EQ(6U, journal.resumed_count());
+  std::vector<std::string> recorded(journal.chunk_names());
+  EXPECT_EQ(6U, recorded.size());
+  EXPECT_NE(recorded.end(), std::find(recorded.begin(), recorded.end(), chunk_names[9]));
+  journal.Complete();
+  EXPECT_FALSE(fs::exists(journal_path));
+}
+
+TEST_F(UserStorageTest, BEH_OfflineJournalReplaysInOrderAcrossRestarts) {
+  fs::path journal_path(*test_dir_ / "offline.journal");
+  std::vector<std::string> chunk_names;
+  for (int i(0); i != 4; ++i)
+    chunk_names.push_back(RandomString(64));
+  std::string data_map(RandomString(100));
+  uint64_t sequence(0);
+  {
+    OfflineJournal journal(journal_path);
+    EXPECT_TRUE(journal.entries(&sequence).empty());
+    journal.RecordChunk(chunk_names[0], 1000);
+    journal.RecordChunk(chunk_names[1], 2000);
+    journal.RecordChange(fs::path("dir") / "file with spaces", data_map);
+    journal.RecordChange("empty", "");
+  }
+  // Simulate a crash part way through appending an entry.
+  {
+    fs::ofstream append(journal_path, std::ios_base::out | std::ios_base::app);
+    append << "C " << EncodeToHex(chunk_names[2]).substr(0, 17);
+  }
+  OfflineJournal journal(journal_path);
+  std::vector<OfflineJournal::Entry> entries(journal.entries(&sequence));
+  ASSERT_EQ(4U, entries.size());
+  EXPECT_EQ(OfflineJournal::Entry::Type::kChunk, entries[1].type);
+  EXPECT_EQ(chunk_names[1], entries[1].chunk_name);
+  EXPECT_EQ(2000U, entries[1].size);
+  EXPECT_EQ(OfflineJournal::Entry::Type::kChange, entries[2].type);
+  EXPECT_EQ(fs::path("dir") / "file with spaces", entries[2].drive_path);
+  EXPECT_EQ(data_map, entries[2].serialised_data_map);
+  EXPECT_TRUE(entries[3].serialised_data_map.empty());
+
+  // Entries recorded after a replay began survive its completion, including over a restart.
+  journal.RecordChunk(chunk_names[3], 3000);
+  journal.Discard(sequence);
+  entries = journal.entries(&sequence);
+  ASSERT_EQ(1U, entries.size());
+  EXPECT_EQ(chunk_names[3], entries[0].chunk_name);
+  uint64_t reloaded_sequence(0);
+  EXPECT_EQ(1U, OfflineJournal(journal_path).entries(&reloaded_sequence).size());
+  journal.Discard(sequence);
+  EXPECT_TRUE(journal.entries(&sequence).empty());
+  EXPECT_FALSE(fs::exists(journal_path));
+}
+
+TEST_F(UserStorageTest, FUNC_OfflineWritesReplayedOnReconnect) {
+  fs::path first_file(*test_dir_ / RandomAlphaNumericString(8)),
+           second_file(*test_dir_ / RandomAlphaNumericString(8));
+  ASSERT_TRUE(WriteFile(first_file, RandomString(2 * 1024 * 1024)));
+  ASSERT_TRUE(WriteFile(second_file, RandomString(2 * 1024 * 1024)));
+  EXPECT_NO_THROW(MountDrive());
+  user_storage_->OnNetworkHealthChange(-1);
+  EXPECT_TRUE(user_storage_->offline());
+
+  // Writes made while offline are served from the local store and held in the journal.
+  EXPECT_NO_THROW(user_storage_->ImportFile(first_file, fs::path("replaced"), nullptr));
+  EXPECT_NO_THROW(user_storage_->ImportFile(second_file, fs::path("replaced"), nullptr));
+  EXPECT_NO_THROW(user_storage_->ImportFile(first_file, fs::path("kept"), nullptr));
+  EXPECT_NO_THROW(user_storage_->Sync());
+  EXPECT_LT(0U, user_storage_->pending_offline_entries());
+  EXPECT_TRUE(CompareFileContents(owner_path() / "replaced", second_file));
+  EXPECT_TRUE(CompareFileContents(owner_path() / "kept", first_file));
+
+  // Once the network returns, the journal is replayed in the background and discarded by the
+  // first sync after the replayed puts are confirmed.
+  user_storage_->OnNetworkHealthChange(100);
+  EXPECT_FALSE(user_storage_->offline());
+  for (int i(0); i != 300 && user_storage_->pending_offline_entries() != 0; ++i) {
+    EXPECT_NO_THROW(user_storage_->Sync());
+    Sleep(bptime::milliseconds(100));
+  }
+  EXPECT_EQ(0U, user_storage_->pending_offline_entries());
+  EXPECT_TRUE(CompareFileContents(owner_path() / "replaced", second_file));
+  EXPECT_TRUE(CompareFileContents(owner_path() / "kept", first_file));
+  EXPECT_NO_THROW(UnMountDrive());
+  EXPECT_EQ(0U, user_storage_->pending_offline_entries());
+
+  // Nothing is left to replay on the next mount, and the replayed versions are the ones read.
+  EXPECT_NO_THROW(MountDrive());
+  EXPECT_EQ(0U, user_storage_->pending_offline_entries());
+  EXPECT_TRUE(CompareFileContents(owner_path() / "replaced", second_file));
+  EXPECT_TRUE(CompareFileContents(owner_path() / "kept", first_file));
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, BEH_PinSetTracksChunksOfNestedPins) {
+  PinSet pin_set;
+  fs::path outer("photos"), inner(outer / "2013");
+  std::string shared(RandomString(64)), outer_only(RandomString(64)), inner_only(RandomString(64));
+  PinSet::ChunkSizes outer_chunks, inner_chunks;
+  outer_chunks[shared] = 1000;
+  outer_chunks[outer_only] = 2000;
+  inner_chunks[shared] = 1000;
+  inner_chunks[inner_only] = 4000;
+
+  // Nothing is tracked for paths which aren't pinned.
+  pin_set.SetFileChunks(outer / "a.jpg", outer_chunks);
+  EXPECT_EQ(0U, pin_set.pinned_bytes());
+  EXPECT_TRUE(pin_set.Pin(outer));
+  EXPECT_FALSE(pin_set.Pin(outer));
+  EXPECT_TRUE(pin_set.Pin(inner));
+  EXPECT_TRUE(pin_set.IsPinned(inner / "b.jpg"));
+  EXPECT_FALSE(pin_set.IsPinned("photos2"));
+  std::map<fs::path, PinSet::ChunkSizes> files;
+  files[outer / "a.jpg"] = outer_chunks;
+  files[inner / "b.jpg"] = inner_chunks;
+  pin_set.SetChunks(outer, files);
+  // Chunks shared between files are counted once.
+  EXPECT_EQ(7000U, pin_set.pinned_bytes());
+  EXPECT_TRUE(pin_set.ContainsChunk(shared));
+
+  // Files still covered by the inner pin stay tracked.
+  EXPECT_TRUE(pin_set.Unpin(outer));
+  EXPECT_FALSE(pin_set.Unpin(outer));
+  EXPECT_EQ(5000U, pin_set.pinned_bytes());
+  EXPECT_FALSE(pin_set.ContainsChunk(outer_only));
+  EXPECT_TRUE(pin_set.ContainsChunk(shared));
+
+  // A refresh replaces what was tracked, dropping files which have gone.
+  pin_set.SetChunks(inner, std::map<fs::path, PinSet::ChunkSizes>());
+  EXPECT_EQ(0U, pin_set.pinned_bytes());
+
+  fs::path pins_path(*test_dir_ / "pins");
+  Identity secret(RandomString(64));
+  pin_set.Save(pins_path, secret);
+  PinSet loaded;
+  EXPECT_FALSE(loaded.Load(pins_path, Identity(RandomString(64))));
+  EXPECT_TRUE(loaded.Load(pins_path, secret));
+  ASSERT_EQ(1U, loaded.pins().size());
+  EXPECT_EQ(inner, loaded.pins().front());
+}
+
+TEST_F(UserStorageTest, BEH_ChunkScrubberRemovesCorruptChunks) {
+  data_store::PermanentStore data_store(*test_dir_ / "store", DiskUsage(1 << 20));
+  encrypt::DataMap data_map;
+  std::vector<ImmutableData::name_type> names;
+  for (int i(0); i != 3; ++i) {
+    std::string content(RandomString(1000));
+    encrypt::ChunkDetails chunk;
+    chunk.hash = crypto::Hash<crypto::SHA512>(content).string();
+    chunk.size = static_cast<uint32_t>(content.size());
+    data_map.chunks.push_back(chunk);
+    names.push_back(ImmutableData::name_type(Identity(chunk.hash)));
+    // The last chunk is truncated, as if by a crash.
+    if (i == 2)
+      content.resize(500);
+    data_store.Put(names.back(), NonEmptyString(content));
+  }
+  // A chunk which isn't held locally is skipped.
+  encrypt::ChunkDetails absent;
+  absent.hash = crypto::Hash<crypto::SHA512>(RandomString(1000)).string();
+  absent.size = 1000;
+  data_map.chunks.push_back(absent);
+
+  ChunkScrubber scrubber(data_store, 1 << 20);
+  scrubber.StartPass();
+  EXPECT_EQ(1U, scrubber.Check(data_map.chunks));
+  EXPECT_NO_THROW(data_store.Get(names[0]));
+  EXPECT_THROW(data_store.Get(names[2]), std::exception);
+  // Files sharing a removed chunk learn of it without it being read again.
+  EXPECT_EQ(1U, scrubber.Check(data_map.chunks));
+  scrubber.RecordReplacements(1, false);
+  scrubber.FinishPass();
+  ChunkScrubber::Progress progress(scrubber.progress());
+  EXPECT_EQ(1U, progress.passes_completed);
+  EXPECT_EQ(3U, progress.chunks_checked);
+  EXPECT_EQ(2500U, progress.bytes_checked);
+  EXPECT_EQ(1U, progress.corrupt_chunks);
+  EXPECT_EQ(1U, progress.replacement_failures);
+
+  scrubber.StartPass();
+  EXPECT_EQ(0U, scrubber.Check(data_map.chunks));
+  EXPECT_EQ(2U, scrubber.progress().chunks_checked);
+}
+
+TEST_F(UserStorageTest, BEH_ContentIndexEvictionAndPersistence) {
+  ContentIndex index(3);
+  std::vector<std::string> hashes;
+  for (int i(0); i != 4; ++i) {
+    hashes.push_back(RandomString(64));
+    index.Add(hashes.back(), 1000 + i, "data map " + std::to_string(i));
+  }
+  EXPECT_EQ(3U, index.size());
+  std::string serialised_data_map;
+  EXPECT_TRUE(index.Find(hashes[3], &serialised_data_map));
+  EXPECT_EQ("data map 3", serialised_data_map);
+  EXPECT_TRUE(index.MayContainSize(1003));
+  EXPECT_FALSE(index.MayContainSize(1004));
+  index.Add(hashes[3], 2000, "replaced");
+  EXPECT_EQ(3U, index.size());
+  EXPECT_FALSE(index.MayContainSize(1003));
+  EXPECT_TRUE(index.MayContainSize(2000));
+
+  // Entries are removed by content or by data map, as when the file they were indexed for is
+  // replaced.
+  ContentIndex removal_index(3);
+  removal_index.Add(hashes[0], 1000, "data map 0");
+  removal_index.Add(hashes[1], 1001, "data map 1");
+  removal_index.RemoveDataMap("data map 0");
+  removal_index.RemoveDataMap("not indexed");
+  EXPECT_FALSE(removal_index.Find(hashes[0], &serialised_data_map));
+  EXPECT_FALSE(removal_index.MayContainSize(1000));
+  removal_index.Remove(hashes[1]);
+  EXPECT_FALSE(removal_index.Find(hashes[1], &serialised_data_map));
+  EXPECT_EQ(0U, removal_index.size());
+
+  fs::path index_path(*test_dir_ / "content.index");
+  index.Save(index_path, session_.unique_user_id());
+  ContentIndex loaded_index(3);
+  EXPECT_FALSE(loaded_index.Load(index_path, Identity(RandomAlphaNumericString(64))));
+  EXPECT_EQ(0U, loaded_index.size());
+  EXPECT_TRUE(loaded_index.Load(index_path, session_.unique_user_id()));
+  EXPECT_EQ(3U, loaded_index.size());
+  EXPECT_TRUE(loaded_index.Find(hashes[3], &serialised_data_map));
+  EXPECT_EQ("replaced", serialised_data_map);
+  EXPECT_TRUE(loaded_index.MayContainSize(2000));
+}
+
+TEST_F(UserStorageTest, BEH_ChunkFilterFalsePositivesAndPersistence) {
+  const int kCapacity(10000);
+  ChunkFilter filter(kCapacity, 0.01);
+  std::vector<std::string> names;
+  for (int i(0); i != kCapacity; ++i) {
+    names.push_back(RandomString(64));
+    filter.Add(names.back());
+  }
+  for (auto& name : names)
+    ASSERT_TRUE(filter.MayContain(name));
+  int false_positives(0);
+  for (int i(0); i != 10 * kCapacity; ++i) {
+    if (filter.MayContain(RandomString(64)))
+      ++false_positives;
+  }
+  double measured_rate(false_positives / (10.0 * kCapacity));
+  EXPECT_LT(measured_rate, 0.02);
+  EXPECT_NEAR(filter.false_positive_rate(), 0.01, 0.005);
+  EXPECT_NEAR(filter.false_positive_rate(), measured_rate, 0.005);
+
+  // A forgotten chunk, such as one whose file was replaced, is reported again once re-added.
+  filter.Forget(names[1]);
+  EXPECT_FALSE(filter.MayContain(names[1]));
+
+  fs::path filter_path(*test_dir_ / "chunks.filter");
+  filter.Save(filter_path);
+  ChunkFilter loaded_filter(kCapacity, 0.01), resized_filter(2 * kCapacity, 0.01);
+  EXPECT_FALSE(resized_filter.Load(filter_path));
+  EXPECT_TRUE(loaded_filter.Load(filter_path));
+  EXPECT_EQ(filter.entry_count(), loaded_filter.entry_count());
+  EXPECT_FALSE(loaded_filter.MayContain(names[1]));
+  loaded_filter.Add(names[1]);
+  for (auto& name : names)
+    ASSERT_TRUE(loaded_filter.MayContain(name));
+
+  // Overfilled, the filter stops reporting hits rather than exceed ten times its target rate.
+  for (int i(0); i != 2 * kCapacity; ++i)
+    loaded_filter.Add(RandomString(64));
+  EXPECT_GT(loaded_filter.false_positive_rate(), 0.1);
+  EXPECT_FALSE(loaded_filter.MayContain(names.front()));
+}
+
+TEST_F(UserStorageTest, BEH_IsZeroFilled) {
+  std::string block(10000, 0);
+  EXPECT_TRUE(IsZeroFilled(block.data(), block.size()));
+  EXPECT_TRUE(IsZeroFilled(block.data(), 0));
+  for (size_t position : { size_t(0), size_t(7), size_t(4095), size_t(4096), size_t(9999) }) {
+    block[position] = 1;
+    EXPECT_FALSE(IsZeroFilled(block.data(), block.size())) << position;
+    EXPECT_TRUE(IsZeroFilled(block.data() + position + 1, block.size() - position - 1))
+        << position;
+    block[position] = 0;
+  }
+}
+
+TEST_F(UserStorageTest, BEH_NfsSchedulerReservesSlotsAndSharesByWeight) {
+  {
+    // Bulk classes can't take the reserved slot.
+    NfsScheduler scheduler(4, 1);
+    std::vector<NfsScheduler::Ticket> tickets(4);
+    for (int i(0); i != 3; ++i)
+      EXPECT_TRUE(scheduler.TryAcquire(NfsPriority::kBackground, 1024, &tickets[i]));
+    EXPECT_FALSE(scheduler.TryAcquire(NfsPriority::kForeground, 1024, &tickets[3]));
+    EXPECT_TRUE(scheduler.TryAcquire(NfsPriority::kSessionCritical, 0, &tickets[3]));
+    for (auto& ticket : tickets)
+      scheduler.Release(ticket);
+    EXPECT_EQ(3U, scheduler.metrics(NfsPriority::kBackground).operations);
+    EXPECT_EQ(1U, scheduler.metrics(NfsPriority::kSessionCritical).operations);
+  }
+
+  // With one slot, equal-sized foreground and background operations queued together are granted
+  // in proportion to their weights.
+  const int kOperationsPerClass(8);
+  NfsScheduler scheduler(2, 0);
+  NfsScheduler::Ticket held, other;
+  ASSERT_TRUE(scheduler.TryAcquire(NfsPriority::kForeground, 1024, &held));
+  ASSERT_TRUE(scheduler.TryAcquire(NfsPriority::kForeground, 1024, &other));
+  std::mutex mutex;
+  std::vector<NfsPriority> grant_order;
+  std::vector<std::thread> threads;
+  for (int i(0); i != kOperationsPerClass; ++i) {
+    for (auto priority : { NfsPriority::kBackground, NfsPriority::kForeground }) {
+      threads.push_back(std::thread([&, priority] {
+        NfsScheduler::Ticket ticket(scheduler.Acquire(priority, 64 * 1024));
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          grant_order.push_back(priority);
+        }
+        scheduler.Release(ticket);
+      }));
+    }
+  }
+  while (scheduler.queued() != threads.size())
+    Sleep(bptime::milliseconds(1));
+  scheduler.Release(other);
+  scheduler.Release(held);
+  for (auto& thread : threads)
+    thread.join();
+  ASSERT_EQ(threads.size(), grant_order.size());
+  int foreground_first(static_cast<int>(std::count(grant_order.begin(),
+                                                   grant_order.begin() + kOperationsPerClass,
+                                                   NfsPriority::kForeground)));
+  EXPECT_GE(foreground_first, kOperationsPerClass - 2);
+  EXPECT_EQ(static_cast<uint64_t>(kOperationsPerClass),
+            scheduler.metrics(NfsPriority::kBackground).operations);
+  EXPECT_EQ(static_cast<uint64_t>(kOperationsPerClass + 2),
+            scheduler.metrics(NfsPriority::kForeground).operations);
+}
+
+TEST_F(UserStorageTest, BEH_TokenBucketShapesBulkTransfers) {
+  const uint64_t kRate(4 * 1024 * 1024), kBurst(256 * 1024);
+  TokenBucket bucket;
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  bucket.Consume(100 * kRate, NfsPriority::kBackground);
+  EXPECT_LT(bptime::microsec_clock::universal_time() - start_time, bptime::milliseconds(50));
+
+  // A new limit starts with a full burst, then bulk transfers proceed at the limit.
+  bucket.SetLimit(kRate, kBurst);
+  bucket.Consume(kBurst, NfsPriority::kForeground);
+  start_time = bptime::microsec_clock::universal_time();
+  for (int i(0); i != 4; ++i)
+    bucket.Consume(kBurst, NfsPriority::kForeground);
+  EXPECT_GE(bptime::microsec_clock::universal_time() - start_time, bptime::milliseconds(200));
+
+  // Session-critical transfers are never delayed, though they are charged.
+  start_time = bptime::microsec_clock::universal_time();
+  bucket.Consume(kRate / 4, NfsPriority::kSessionCritical);
+  EXPECT_LT(bptime::microsec_clock::universal_time() - start_time, bptime::milliseconds(50));
+
+  // Halving the bulk share halves the bulk rate.
+  bucket.set_bulk_share(0.5);
+  start_time = bptime::microsec_clock::universal_time();
+  for (int i(0); i != 2; ++i)
+    bucket.Consume(kBurst / 2, NfsPriority::kBackground);
+  EXPECT_GE(bptime::microsec_clock::universal_time() - start_time, bptime::milliseconds(250));
+  bucket.set_bulk_share(0.0);
+  EXPECT_EQ(TokenBucket::kMinimumBulkShare, bucket.bulk_share());
+
+  bucket.SetLimit(0, 0);
+  start_time = bptime::microsec_clock::universal_time();
+  bucket.Consume(100 * kRate, NfsPriority::kForeground);
+  EXPECT_LT(bptime::microsec_clock::universal_time() - start_time, bptime::milliseconds(50));
+
+  // A reduced bulk share also limits the scheduler's bulk slots, but not the reserved classes.
+  NfsScheduler scheduler(5, 1);
+  scheduler.set_bulk_share(0.25);
+  NfsScheduler::Ticket first, second, third;
+  EXPECT_TRUE(scheduler.TryAcquire(NfsPriority::kBackground, 1024, &first));
+  EXPECT_FALSE(scheduler.TryAcquire(NfsPriority::kForeground, 1024, &second));
+  EXPECT_TRUE(scheduler.TryAcquire(NfsPriority::kInteractive, 1024, &second));
+  scheduler.set_bulk_share(1.0);
+  EXPECT_TRUE(scheduler.TryAcquire(NfsPriority::kForeground, 1024, &third));
+  scheduler.Release(first);
+  scheduler.Release(second);
+  scheduler.Release(third);
+}
+
 TEST_F(UserStorageTest, BEH_CopyEmptyDirectoryToDrive) {
   EXPECT_NO_THROW(MountDrive());
   fs::path directory(CreateTestDirectory(*test_dir_));
@@ -470,77 +1115,734 @@ TEST_F(UserStorageTest, FUNC_CheckFailures) {
   EXPECT_NO_THROW(UnMountDrive());
 }
 
+TEST_F(UserStorageTest, BEH_UnMountDriveHandsOffFlush) {
+  std::mutex mutex;
+  std::vector<bool> pending_reports;
+  user_storage_.reset(new UserStorage([&](bool pending) {
+                                        std::lock_guard<std::mutex> lock(mutex);
+                                        pending_reports.push_back(pending);
+                                      }));
+  EXPECT_NO_THROW(MountDrive());
+  int64_t file_size(0);
+  fs::path directory(CreateTestDirectory(*test_dir_));
+  fs::path file(CreateTestFile(directory, file_size));
+  ASSERT_TRUE(CopyDirectories(directory, owner_path()));
+  EXPECT_NO_THROW(UnMountDrive());
+  EXPECT_FALSE(user_storage_->mount_status());
+  user_storage_->WaitForPendingFlush(session_);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(2U, pending_reports.size());
+    EXPECT_TRUE(pending_reports.front());
+    EXPECT_FALSE(pending_reports.back());
+  }
+  EXPECT_NO_THROW(MountDrive());
+  EXPECT_TRUE(fs::exists(owner_path() / directory.filename() / file.filename()));
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_ImportDirectoryAgainstFuseCopy) {
+  EXPECT_NO_THROW(MountDrive());
+  TestTree tree(CreateTestTree());
+  fs::path source(tree.root);
+  uint32_t total_size(tree.total_size);
+
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  ASSERT_TRUE(CopyDirectories(source, owner_path()));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "Through FUSE: ";
+  PrintResult(start_time, stop_time, total_size, kCopy);
+
+  fs::path import_path(RandomAlphaNumericString(8));
+  uint64_t reported_done(0), reported_total(0);
+  start_time = bptime::microsec_clock::universal_time();
+  EXPECT_NO_THROW(user_storage_->ImportDirectory(source, import_path,
+                                                 [&](uint64_t done, uint64_t total) {
+                                                   reported_done = done;
+                                                   reported_total = total;
+                                                 }));
+  stop_time = bptime::microsec_clock::universal_time();
+  std::cout << "ImportDirectory: ";
+  PrintResult(start_time, stop_time, total_size, kCopy);
+
+  EXPECT_EQ(total_size, reported_total);
+  EXPECT_EQ(reported_total, reported_done);
+  EXPECT_TRUE(CompareDirectoryEntries(owner_path() / import_path, source));
+  for (auto& file : tree.files) {
+    EXPECT_TRUE(CompareFileContents(owner_path() / import_path / file.relative_path,
+                                    file.local_path)) << file.local_path;
+  }
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_ExportDirectoryThroughputAndResume) {
+  EXPECT_NO_THROW(MountDrive());
+  fs::path import_path(RandomAlphaNumericString(8));
+  TestTree tree(ImportTestTree(import_path));
+  fs::path source(tree.root);
+  uint32_t total_size(tree.total_size);
+
+  fs::path export_path(*test_dir_ / RandomAlphaNumericString(8));
+  uint64_t reported_done(0), reported_total(0);
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  EXPECT_NO_THROW(user_storage_->ExportDirectory(import_path, export_path,
+                                                 [&](uint64_t done, uint64_t total) {
+                                                   reported_done = done;
+                                                   reported_total = total;
+                                                 }));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "ExportDirectory: ";
+  PrintResult(start_time, stop_time, total_size, kRead);
+  EXPECT_EQ(total_size, reported_total);
+  EXPECT_EQ(reported_total, reported_done);
+  EXPECT_FALSE(fs::exists(export_path / kExportManifestName));
+  EXPECT_TRUE(CompareDirectoryEntries(export_path, source));
+
+  // Interrupt an export about halfway through, then check a second call resumes and completes it.
+  fs::path resume_path(*test_dir_ / RandomAlphaNumericString(8));
+  EXPECT_THROW(user_storage_->ExportDirectory(import_path, resume_path,
+                                              [](uint64_t done, uint64_t total) {
+                                                if (done > total / 2)
+                                                  ThrowError(CommonErrors::unknown);
+                                              }),
+               std::exception);
+  EXPECT_TRUE(fs::exists(resume_path / kExportManifestName));
+  EXPECT_NO_THROW(user_storage_->ExportDirectory(import_path, resume_path, nullptr));
+  EXPECT_FALSE(fs::exists(resume_path / kExportManifestName));
+  EXPECT_TRUE(CompareDirectoryEntries(resume_path, source));
+  for (auto& file : tree.files) {
+    EXPECT_TRUE(CompareFileContents(export_path / file.relative_path, file.local_path))
+        << file.local_path;
+    EXPECT_TRUE(CompareFileContents(resume_path / file.relative_path, file.local_path))
+        << file.local_path;
+  }
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
 TEST_F(UserStorageTest, FUNC_FunctionalTest) {
   EXPECT_NO_THROW(MountDrive());
   EXPECT_TRUE(DoRandomEvents(owner_path(), *test_dir_));
   EXPECT_NO_THROW(UnMountDrive());
 }
 
+TEST_F(UserStorageTest, FUNC_GetAndInsertDataMap) {
+  EXPECT_NO_THROW(MountDrive());
+  fs::path file(CreateTestFileWithSize(owner_path(), 722));
+  fs::path file_name(file.filename()), file_name_copy(file_name.string() + "_copy");
+
+  std::string file_content, copy_file_content;
+  EXPECT_TRUE(ReadFile(owner_path() / file_name, &file_content));
+  std::string serialised_data_map, serialised_data_map_copy;
+  EXPECT_NO_THROW(serialised_data_map = user_storage_->GetDataMap(file_name));
+  EXPECT_FALSE(serialised_data_map.empty());
+  EXPECT_NO_THROW(user_storage_->InsertDataMap(file_name_copy, serialised_data_map));
+  EXPECT_TRUE(ReadFile(owner_path() / file_name_copy, &copy_file_content));
+  EXPECT_EQ(file_content, copy_file_content);
+  EXPECT_NO_THROW(serialised_data_map_copy = user_storage_->GetDataMap(file_name_copy));
+  EXPECT_EQ(serialised_data_map, serialised_data_map_copy);
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_SaveDataMapAndConstructFile) {
+  EXPECT_NO_THROW(MountDrive());
+  fs::path file(CreateTestFileWithSize(owner_path(), 722));
+  fs::path file_name(file.filename()), file_name_copy(file_name.string() + "_copy");
+  std::string file_content, copy_file_content, serialised_data_map;
+  EXPECT_TRUE(ReadFile(owner_path() / file_name, &file_content));
+  EXPECT_NO_THROW(serialised_data_map = user_storage_->GetDataMap(file_name));
+  fs::path saved_data_map(*test_dir_ / "saved_data_map");
+  EXPECT_TRUE(WriteFile(saved_data_map, serialised_data_map));
+  EXPECT_NO_THROW(UnMountDrive());
+
+  // Construct the file in a fresh mount from the saved data map alone.
+  EXPECT_NO_THROW(MountDrive());
+  std::string saved_content;
+  EXPECT_TRUE(ReadFile(saved_data_map, &saved_content));
+  EXPECT_NO_THROW(user_storage_->InsertDataMap(file_name_copy, saved_content));
+  EXPECT_TRUE(ReadFile(owner_path() / file_name_copy, &copy_file_content));
+  EXPECT_EQ(file_content, copy_file_content);
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_CopyFileAgainstFuseCopy) {
+  EXPECT_NO_THROW(MountDrive());
+  const uint32_t kFileSize(64 * 1024 * 1024);
+  fs::path file(CreateTestFileWithSize(owner_path(), kFileSize)), file_name(file.filename());
+
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  fs::copy_file(file, owner_path() / (file_name.string() + "_fuse"));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "Through FUSE: ";
+  PrintResult(start_time, stop_time, kFileSize, kCopy);
+
+  start_time = bptime::microsec_clock::universal_time();
+  EXPECT_NO_THROW(user_storage_->CopyFile(file_name, file_name.string() + "_clone"));
+  stop_time = bptime::microsec_clock::universal_time();
+  std::cout << "CopyFile: ";
+  PrintResult(start_time, stop_time, kFileSize, kCopy);
+
+  EXPECT_TRUE(CompareFileContents(file, owner_path() / (file_name.string() + "_clone")));
+  EXPECT_EQ(user_storage_->GetDataMap(file_name),
+            user_storage_->GetDataMap(file_name.string() + "_clone"));
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_MountProfileThroughputMatrix) {
+  TestTree tree(CreateTestTree());
+  fs::path source(tree.root);
+  uint32_t total_size(tree.total_size);
+  const uint32_t kWorkerCounts[] = { 1, 2, std::max(2U, std::thread::hardware_concurrency()) };
+  const uint32_t kBlockSizes[] = { 64 * 1024, 1024 * 1024 };
+
+  for (auto worker_count : kWorkerCounts) {
+    for (auto block_size : kBlockSizes) {
+      MountProfile profile;
+      profile.worker_count = worker_count;
+      profile.max_read_size = block_size;
+      profile.max_write_size = block_size;
+      user_storage_->MountDrive(*client_nfs_, session_, profile);
+      ASSERT_TRUE(user_storage_->mount_status());
+      EXPECT_EQ(worker_count, user_storage_->mount_profile().worker_count);
+
+      fs::path drive_path(RandomAlphaNumericString(8));
+      fs::path local_path(*test_dir_ / RandomAlphaNumericString(8));
+      std::cout << worker_count << " workers, " << block_size / 1024 << " KB blocks: ";
+      bptime::ptime start_time(bptime::microsec_clock::universal_time());
+      EXPECT_NO_THROW(user_storage_->ImportDirectory(source, drive_path, nullptr));
+      bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+      std::cout << "import ";
+      PrintResult(start_time, stop_time, total_size, kCopy);
+      start_time = bptime::microsec_clock::universal_time();
+      EXPECT_NO_THROW(user_storage_->ExportDirectory(drive_path, local_path, nullptr));
+      stop_time = bptime::microsec_clock::universal_time();
+      std::cout << "export ";
+      PrintResult(start_time, stop_time, total_size, kRead);
+      EXPECT_TRUE(CompareDirectoryEntries(local_path, source));
+      EXPECT_NO_THROW(UnMountDrive());
+    }
+  }
+}
+
+TEST_F(UserStorageTest, FUNC_ListDirectoryFromTreeIndexAfterRemount) {
+  EXPECT_NO_THROW(MountDrive());
+  fs::path drive_path(RandomAlphaNumericString(8));
+  fs::path source(ImportTestTree(drive_path).root);
+  std::set<std::string> expected;
+  for (fs::directory_iterator itr(source), end; itr != end; ++itr)
+    expected.insert(itr->path().filename().string());
+  std::vector<DirectoryEntry> entries(user_storage_->ListDirectory(drive_path));
+  EXPECT_EQ(expected.size(), entries.size());
+  EXPECT_NO_THROW(UnMountDrive());
+
+  EXPECT_NO_THROW(MountDrive());
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  EXPECT_NO_THROW(entries = user_storage_->ListDirectory(drive_path));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "First listing after mount took " << (stop_time - start_time).total_microseconds()
+            << " us." << std::endl;
+  std::set<std::string> listed;
+  for (auto& entry : entries) {
+    listed.insert(entry.name);
+    DirectoryEntry found(user_storage_->GetDirectoryEntry(drive_path / entry.name));
+    EXPECT_EQ(entry.is_directory, found.is_directory);
+    EXPECT_EQ(entry.size, found.size);
+  }
+  EXPECT_EQ(expected, listed);
+  EXPECT_THROW(user_storage_->GetDirectoryEntry(drive_path / RandomAlphaNumericString(9)),
+               std::exception);
 
+  // Copying a file in through UserStorage must show up in the next listing.
+  auto file(std::find_if(entries.begin(), entries.end(),
+                         [](const DirectoryEntry& entry) { return !entry.is_directory; }));
+  if (file != entries.end()) {
+    EXPECT_NO_THROW(user_storage_->CopyFile(drive_path / file->name,
+                                            drive_path / RandomAlphaNumericString(9)));
+    EXPECT_EQ(expected.size() + 1, user_storage_->ListDirectory(drive_path).size());
+  }
 
+  // Files created and deleted through the mounted drive bypass the index, but must still show up.
+  fs::path fuse_file(drive_path / RandomAlphaNumericString(10));
+  WriteFile(user_storage_->owner_path() / fuse_file, RandomString(100));
+  entries = user_storage_->ListDirectory(drive_path);
+  EXPECT_TRUE(std::any_of(entries.begin(), entries.end(), [&](const DirectoryEntry& entry) {
+                            return entry.name == fuse_file.filename().string();
+                          }));
+  EXPECT_EQ(100U, user_storage_->GetDirectoryEntry(fuse_file).size);
+  boost::system::error_code error_code;
+  fs::remove(user_storage_->owner_path() / fuse_file, error_code);
+  entries = user_storage_->ListDirectory(drive_path);
+  EXPECT_TRUE(std::none_of(entries.begin(), entries.end(), [&](const DirectoryEntry& entry) {
+                             return entry.name == fuse_file.filename().string();
+                           }));
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_MetadataLookupsAgainstFuse) {
+  EXPECT_NO_THROW(MountDrive());
+  fs::path drive_path(RandomAlphaNumericString(8));
+  TestTree tree(ImportTestTree(drive_path));
+  std::vector<fs::path> lookups;
+  for (auto& file : tree.files)
+    lookups.push_back(drive_path / file.relative_path);
+  const char* kProbedNames[] = { ".git", "desktop.ini", ".DS_Store", "Thumbs.db" };
+  for (auto& probed_name : kProbedNames)
+    lookups.push_back(drive_path / probed_name);
+  const int kRounds(20);
+
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  for (int round(0); round != kRounds; ++round) {
+    for (auto& lookup : lookups) {
+      boost::system::error_code error_code;
+      fs::status(owner_path() / lookup, error_code);
+    }
+  }
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  uint64_t fuse_us((stop_time - start_time).total_microseconds());
 
-//TEST_F(UserStorageTest, FUNC_GetAndInsertDataMap) {
-//  MountDrive(user_storage1_, &session1_);
-//  fs::path mount_dir(user_storage1_->mount_dir());
-//
-//  std::string file_name, file_name_copy;
-//  EXPECT_EQ(kSuccess, CreateSmallTestFile(mount_dir, 722, &file_name));
-//  file_name_copy = file_name + "_copy";
-//
-//  std::string file_content, copy_file_content;
-//  EXPECT_TRUE(ReadFile(mount_dir / file_name, &file_content));
-//  std::string serialised_data_map, serialised_data_map_copy;
-//  EXPECT_EQ(kSuccess, user_storage1_->GetDataMap(mount_dir / file_name, &serialised_data_map));
-//  EXPECT_FALSE(serialised_data_map.empty());
-//  EXPECT_EQ(kSuccess, user_storage1_->InsertDataMap(mount_dir / file_name_copy,
-//                                                    NonEmptyString(serialised_data_map)));
-//  EXPECT_TRUE(ReadFile(mount_dir / file_name_copy, &copy_file_content));
-//  EXPECT_EQ(file_content, copy_file_content);
-//  EXPECT_EQ(kSuccess,
-//            user_storage1_->GetDataMap(mount_dir / file_name_copy, &serialised_data_map_copy));
-//  EXPECT_EQ(serialised_data_map, serialised_data_map_copy);
-//
-//  UnMountDrive(user_storage1_);
-//
-//  // Try the data map in the other user
-//  MountDrive(user_storage2_, &session2_);
-//  mount_dir = user_storage2_->mount_dir();
-//
-//  EXPECT_EQ(kSuccess, user_storage2_->InsertDataMap(mount_dir / file_name,
-//                                                    NonEmptyString(serialised_data_map)));
-//  EXPECT_TRUE(ReadFile(mount_dir / file_name, &copy_file_content));
-//  EXPECT_EQ(file_content, copy_file_content);
-//
-//  UnMountDrive(user_storage2_);
-//}
-//
-//TEST_F(UserStorageTest, FUNC_SaveDataMapAndConstructFile) {
-//  MountDrive(user_storage1_, &session1_);
-//  fs::path mount_dir(user_storage1_->mount_dir());
-//
-//  std::string file_name, file_name_copy, retrived_file_name_copy;
-//  EXPECT_EQ(kSuccess, CreateSmallTestFile(mount_dir, 722, &file_name));
-//  file_name_copy = file_name + "_copy";
-//
-//  std::string file_content, copy_file_content;
-//  EXPECT_TRUE(ReadFile(mount_dir / file_name, &file_content));
-//  std::string serialised_data_map, serialised_data_map_copy;
-//  EXPECT_EQ(kSuccess, user_storage1_->GetDataMap(mount_dir / file_name, &serialised_data_map));
-//  std::string data_map_hash;
-//  EXPECT_TRUE(user_storage1_->ParseAndSaveDataMap(NonEmptyString(file_name_copy),
-//                                                  NonEmptyString(serialised_data_map),
-//                                                  data_map_hash));
-//  EXPECT_TRUE(user_storage1_->GetSavedDataMap(NonEmptyString(data_map_hash),
-//                                              serialised_data_map_copy,
-//                                              retrived_file_name_copy));
-//  EXPECT_EQ(serialised_data_map, serialised_data_map_copy);
-//  EXPECT_EQ(file_name_copy, retrived_file_name_copy);
-//  EXPECT_EQ(kSuccess, user_storage1_->InsertDataMap(mount_dir / file_name_copy,
-//                                                    NonEmptyString(serialised_data_map_copy)));
-//  EXPECT_TRUE(ReadFile(mount_dir / retrived_file_name_copy, &copy_file_content));
-//  EXPECT_EQ(file_content, copy_file_content);
-//  UnMountDrive(user_storage1_);
-//}
+  uint64_t found(0), not_found(0);
+  start_time = bptime::microsec_clock::universal_time();
+  for (int round(0); round != kRounds; ++round) {
+    for (auto& lookup : lookups) {
+      try {
+        user_storage_->GetDirectoryEntry(lookup);
+        ++found;
+      }
+      catch(const std::exception&) {
+        ++not_found;
+      }
+    }
+  }
+  stop_time = bptime::microsec_clock::universal_time();
+  uint64_t cached_us((stop_time - start_time).total_microseconds());
+  uint64_t operations(kRounds * lookups.size());
+  std::cout << "Through FUSE: " << operations * 1000000 / std::max(fuse_us, uint64_t(1))
+            << " lookups/s, cached: " << operations * 1000000 / std::max(cached_us, uint64_t(1))
+            << " lookups/s" << std::endl;
+  EXPECT_EQ(kRounds * tree.files.size(), found);
+  EXPECT_EQ(kRounds * (sizeof(kProbedNames) / sizeof(kProbedNames[0])), not_found);
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_PaginatedListingOfLargeDirectory) {
+  EXPECT_NO_THROW(MountDrive());
+  fs::path directory(RandomAlphaNumericString(8));
+  ASSERT_TRUE(fs::create_directory(owner_path() / directory));
+  fs::path file(CreateTestFileWithSize(owner_path() / directory, 1024));
+  const size_t kEntryCount(5000), kPageSize(500);
+  EXPECT_EQ(1U, user_storage_->ListDirectory(directory).size());
+
+  // Each copy patches the indexed listing rather than forcing the directory to be re-read.
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  for (size_t i(1); i != kEntryCount; ++i) {
+    EXPECT_NO_THROW(user_storage_->CopyFile(directory / file.filename(),
+                                            directory / RandomAlphaNumericString(16)));
+  }
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "Inserted " << kEntryCount - 1 << " entries in "
+            << (stop_time - start_time).total_milliseconds() << " ms." << std::endl;
+
+  std::string start_after;
+  size_t listed(0), pages(0);
+  start_time = bptime::microsec_clock::universal_time();
+  for (;;) {
+    std::vector<DirectoryEntry> page(user_storage_->ListDirectory(directory, start_after,
+                                                                  kPageSize));
+    if (page.empty())
+      break;
+    EXPECT_GE(kPageSize, page.size());
+    for (auto& entry : page) {
+      EXPECT_LT(start_after, entry.name);
+      start_after = entry.name;
+    }
+    listed += page.size();
+    ++pages;
+  }
+  stop_time = bptime::microsec_clock::universal_time();
+  std::cout << "Listed " << listed << " entries in " << pages << " pages in "
+            << (stop_time - start_time).total_milliseconds() << " ms." << std::endl;
+  EXPECT_EQ(kEntryCount, listed);
+  EXPECT_EQ(kEntryCount / kPageSize, pages);
+  size_t through_fuse(std::distance(fs::directory_iterator(owner_path() / directory),
+                                    fs::directory_iterator()));
+  EXPECT_EQ(kEntryCount, through_fuse);
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_TakeAndRestoreSnapshot) {
+  EXPECT_NO_THROW(MountDrive());
+  fs::path live_path(RandomAlphaNumericString(8));
+  TestTree tree(ImportTestTree(live_path));
+  fs::path source(tree.root);
+
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  EXPECT_NO_THROW(user_storage_->TakeSnapshot("first", session_));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "TakeSnapshot of " << tree.files.size() << " files took "
+            << (stop_time - start_time).total_milliseconds() << " ms." << std::endl;
+  EXPECT_THROW(user_storage_->TakeSnapshot("first", session_), std::exception);
+  ASSERT_EQ(1U, session_.snapshots().count("first"));
+
+  // Change the live tree; the snapshot must still hold the original contents.
+  for (auto& file : tree.files)
+    EXPECT_TRUE(WriteFile(owner_path() / live_path / file.relative_path, "modified"));
+  fs::path restore_path(RandomAlphaNumericString(8));
+  EXPECT_NO_THROW(user_storage_->RestoreSnapshot("first", restore_path, session_));
+  EXPECT_TRUE(CompareDirectoryEntries(owner_path() / restore_path / live_path, source));
+  for (auto& file : tree.files) {
+    EXPECT_TRUE(CompareFileContents(owner_path() / restore_path / live_path / file.relative_path,
+                                    file.local_path)) << file.local_path;
+  }
+  EXPECT_THROW(user_storage_->RestoreSnapshot("missing", restore_path, session_),
+               std::exception);
+
+  // Snapshots survive serialisation of the session.
+  Session parsed_session;
+  parsed_session.Parse(session_.Serialise());
+  ASSERT_EQ(1U, parsed_session.snapshots().count("first"));
+  EXPECT_EQ(session_.snapshots()["first"].manifest_data_map,
+            parsed_session.snapshots()["first"].manifest_data_map);
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_ImportOverQuotaRejectedBeforeUpload) {
+  TestTree tree(CreateTestTree(5, 20));
+  fs::path source(tree.root);
+  uint32_t total_size(tree.total_size);
+  session_.set_used_space(0);
+  session_.set_max_space(total_size / 2);
+  EXPECT_NO_THROW(MountDrive());
+  EXPECT_EQ(total_size / 2, user_storage_->max_space());
+  EXPECT_THROW(user_storage_->ImportDirectory(source, fs::path("too_big"), nullptr),
+               std::exception);
+  EXPECT_EQ(0, user_storage_->used_space());
+  EXPECT_FALSE(fs::exists(owner_path() / "too_big"));
+
+  EXPECT_NO_THROW(UnMountDrive());
+  user_storage_->WaitForPendingFlush(session_);
+  session_.set_used_space(0);
+  session_.set_max_space(static_cast<int64_t>(total_size) * 4);
+  EXPECT_NO_THROW(MountDrive());
+  EXPECT_NO_THROW(user_storage_->ImportDirectory(source, fs::path("fits"), nullptr));
+  EXPECT_GT(user_storage_->used_space(), 0);
+  EXPECT_LE(user_storage_->used_space(), user_storage_->max_space());
+  EXPECT_NO_THROW(UnMountDrive());
+  user_storage_->WaitForPendingFlush(session_);
+  EXPECT_GE(session_.used_space(), static_cast<int64_t>(total_size) / 2);
+}
+
+TEST_F(UserStorageTest, FUNC_SingleFileImportThroughput) {
+  const uint64_t kFileSizes[] = { 1ULL << 20, 16ULL << 20, 256ULL << 20, 1ULL << 30, 10ULL << 30 };
+  const uint32_t kBlockSize(1024 * 1024);
+  session_.set_max_space(static_cast<int64_t>(32ULL << 30));
+  EXPECT_NO_THROW(MountDrive());
+  for (auto file_size : kFileSizes) {
+    fs::path file(*test_dir_ / RandomAlphaNumericString(8));
+    {
+      fs::ofstream output(file, std::ios_base::out | std::ios_base::binary);
+      for (uint64_t written(0); written < file_size; written += kBlockSize)
+        output << RandomString(kBlockSize);
+    }
+    uint64_t reported_done(0);
+    bptime::ptime start_time(bptime::microsec_clock::universal_time());
+    EXPECT_NO_THROW(user_storage_->ImportFile(file, file.filename(),
+                                              [&](uint64_t done, uint64_t /*total*/) {
+                                                reported_done = done;
+                                              }));
+    bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+    std::cout << "ImportFile " << (file_size >> 20) << " MB: ";
+    PrintResult(start_time, stop_time, static_cast<size_t>(file_size), kCopy);
+    EXPECT_EQ(file_size, reported_done);
+    EXPECT_EQ(file_size, fs::file_size(owner_path() / file.filename()));
+    if (file_size <= (256ULL << 20)) {
+      EXPECT_TRUE(CompareFileContents(owner_path() / file.filename(), file));
+    }
+    boost::system::error_code error_code;
+    fs::remove(file, error_code);
+  }
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_AppendToLargeFile) {
+  const uint64_t kFileSize(1ULL << 30);
+  const uint32_t kBlockSize(1024 * 1024), kAppendSize(4096), kAppendCount(10);
+  session_.set_max_space(static_cast<int64_t>(4ULL << 30));
+  EXPECT_NO_THROW(MountDrive());
+  fs::path file(*test_dir_ / RandomAlphaNumericString(8)), file_name(file.filename());
+  {
+    fs::ofstream output(file, std::ios_base::out | std::ios_base::binary);
+    for (uint64_t written(0); written < kFileSize; written += kBlockSize)
+      output << RandomString(kBlockSize);
+  }
+  EXPECT_NO_THROW(user_storage_->ImportFile(file, file_name, nullptr));
+
+  std::string content;
+  for (uint32_t i(0); i != kAppendCount; ++i) {
+    encrypt::DataMapPtr before(ParseDataMap(user_storage_->GetDataMap(file_name)));
+    std::set<std::string> existing_chunks;
+    for (auto& chunk : before->chunks)
+      existing_chunks.insert(chunk.hash);
+    content = RandomString(kAppendSize);
+    bptime::ptime start_time(bptime::microsec_clock::universal_time());
+    EXPECT_NO_THROW(user_storage_->AppendToFile(file_name, content));
+    bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+    encrypt::DataMapPtr after(ParseDataMap(user_storage_->GetDataMap(file_name)));
+    uint64_t reuploaded(0);
+    for (auto& chunk : after->chunks) {
+      if (existing_chunks.count(chunk.hash) == 0)
+        reuploaded += chunk.size;
+    }
+    std::cout << "Append " << i << ": " << reuploaded << " bytes re-uploaded, ";
+    PrintResult(start_time, stop_time, kAppendSize, kCopy);
+    EXPECT_LT(reuploaded, 8ULL * kBlockSize);
+  }
+
+  uint64_t expected_size(kFileSize + static_cast<uint64_t>(kAppendSize) * kAppendCount);
+  EXPECT_EQ(expected_size, fs::file_size(owner_path() / file_name));
+  fs::ifstream input(owner_path() / file_name, std::ios_base::in | std::ios_base::binary);
+  input.seekg(expected_size - kAppendSize);
+  std::string tail(kAppendSize, 0);
+  input.read(&tail[0], kAppendSize);
+  EXPECT_EQ(content, tail);
+  input.close();
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_SmallFilesStoredInline) {
+  fs::path source(*test_dir_ / "small_files");
+  fs::create_directories(source);
+  uint32_t total_size(0);
+  for (int i(0); i != 500; ++i) {
+    size_t size(100 + RandomUint32() % (12 * 1024));
+    CreateTestFileWithSize(source, size);
+    total_size += static_cast<uint32_t>(size);
+  }
+
+  // A limit below the encryptor's own inline threshold leaves every file to be chunked.
+  const uint32_t kInlineLimits[] = { 1, 0 };
+  for (auto inline_limit : kInlineLimits) {
+    MountProfile profile;
+    profile.max_inline_file_size = inline_limit;
+    user_storage_->MountDrive(*client_nfs_, session_, profile);
+    ASSERT_TRUE(user_storage_->mount_status());
+    fs::path drive_path(RandomAlphaNumericString(8));
+    bptime::ptime start_time(bptime::microsec_clock::universal_time());
+    EXPECT_NO_THROW(user_storage_->ImportDirectory(source, drive_path, nullptr));
+    bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+    std::cout << "Inline limit " << user_storage_->mount_profile().max_inline_file_size << ": ";
+    PrintResult(start_time, stop_time, total_size, kCopy);
+
+    fs::directory_iterator end;
+    for (fs::directory_iterator itr(source); itr != end; ++itr) {
+      fs::path file_name(itr->path().filename());
+      EXPECT_TRUE(CompareFileContents(owner_path() / drive_path / file_name, itr->path()));
+      if (inline_limit == 0) {
+        encrypt::DataMapPtr data_map(ParseDataMap(user_storage_->GetDataMap(drive_path /
+                                                                            file_name)));
+        EXPECT_TRUE(data_map->chunks.empty()) << file_name;
+      }
+    }
+    EXPECT_NO_THROW(UnMountDrive());
+    user_storage_->WaitForPendingFlush(session_);
+  }
+}
+
+TEST_F(UserStorageTest, FUNC_ReimportOfIdenticalContentReusesDataMaps) {
+  TestTree tree(CreateTestTree());
+  fs::path source(tree.root), first_path("first"), second_path("second");
+  uint32_t total_size(tree.total_size);
+  EXPECT_NO_THROW(MountDrive());
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  EXPECT_NO_THROW(user_storage_->ImportDirectory(source, first_path, nullptr));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "First import: ";
+  PrintResult(start_time, stop_time, total_size, kCopy);
+  // The index survives a remount.
+  EXPECT_NO_THROW(UnMountDrive());
+  EXPECT_NO_THROW(MountDrive());
+
+  start_time = bptime::microsec_clock::universal_time();
+  EXPECT_NO_THROW(user_storage_->ImportDirectory(source, second_path, nullptr));
+  stop_time = bptime::microsec_clock::universal_time();
+  std::cout << "Identical re-import: ";
+  PrintResult(start_time, stop_time, total_size, kCopy);
+
+  for (auto& file : tree.files) {
+    EXPECT_EQ(user_storage_->GetDataMap(first_path / file.relative_path),
+              user_storage_->GetDataMap(second_path / file.relative_path)) << file.relative_path;
+    EXPECT_TRUE(CompareFileContents(owner_path() / second_path / file.relative_path,
+                                    file.local_path));
+  }
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_ChunkFilterSkipsPutsAfterRemount) {
+  fs::path local_file(*test_dir_ / RandomAlphaNumericString(8));
+  ASSERT_TRUE(WriteFile(local_file, RandomString(4 * 1024 * 1024)));
+  EXPECT_NO_THROW(MountDrive());
+  EXPECT_NO_THROW(user_storage_->ImportFile(local_file, fs::path("first"), nullptr));
+  EXPECT_EQ(0U, user_storage_->chunks_filtered());
+  // The filter is saved once the unmount's flush has confirmed the puts.
+  EXPECT_NO_THROW(UnMountDrive());
+  user_storage_->WaitForPendingFlush(session_);
+
+  EXPECT_NO_THROW(MountDrive());
+  EXPECT_NO_THROW(user_storage_->ImportFile(local_file, fs::path("second"), nullptr));
+  encrypt::DataMapPtr data_map(ParseDataMap(user_storage_->GetDataMap(fs::path("second"))));
+  ASSERT_FALSE(data_map->chunks.empty());
+  EXPECT_EQ(data_map->chunks.size(), user_storage_->chunks_filtered());
+  EXPECT_TRUE(CompareFileContents(owner_path() / "second", local_file));
+  EXPECT_NO_THROW(UnMountDrive());
+  EXPECT_EQ(0U, user_storage_->chunks_filtered());
+}
+
+TEST_F(UserStorageTest, FUNC_CompressionByWorkload) {
+  const uint64_t kFileSize(64ULL << 20);
+  const uint32_t kBlockSize(1024 * 1024);
+  const std::string kLogLine("2013-06-01 12:00:00.000 INFO [vault] Stored chunk\n");
+  std::vector<std::pair<std::string, std::function<std::string()>>> workloads;
+  workloads.push_back(std::make_pair("Log", [&]()->std::string {
+    std::string block;
+    while (block.size() < kBlockSize)
+      block += kLogLine;
+    block.resize(kBlockSize);
+    return block;
+  }));
+  workloads.push_back(std::make_pair("Text", [&]() {
+    return RandomAlphaNumericString(kBlockSize);
+  }));
+  workloads.push_back(std::make_pair("Random", [&]() { return RandomString(kBlockSize); }));
+  EXPECT_NO_THROW(MountDrive());
+  for (auto& workload : workloads) {
+    fs::path file(*test_dir_ / RandomAlphaNumericString(8));
+    {
+      fs::ofstream output(file, std::ios_base::out | std::ios_base::binary);
+      for (uint64_t written(0); written < kFileSize; written += kBlockSize)
+        output << workload.second();
+    }
+    double ratio(EstimateStoredRatio(file, kFileSize));
+    int64_t used_before(user_storage_->used_space());
+    bptime::ptime start_time(bptime::microsec_clock::universal_time());
+    EXPECT_NO_THROW(user_storage_->ImportFile(file, file.filename(), nullptr));
+    bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+    int64_t stored(user_storage_->used_space() - used_before);
+    std::cout << workload.first << ": " << kFileSize << " bytes, " << stored
+              << " stored, sampled ratio " << ratio << ", ";
+    PrintResult(start_time, stop_time, static_cast<size_t>(kFileSize), kCopy);
+    EXPECT_GT(stored, 0);
+    EXPECT_LE(static_cast<uint64_t>(stored), kFileSize + kFileSize / 100);
+    EXPECT_TRUE(CompareFileContents(owner_path() / file.filename(), file));
+  }
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_SparseFileImportAndExport) {
+  const uint64_t kFileSize(1ULL << 30);
+  const uint32_t kDataSize(1024 * 1024);
+  fs::path source(*test_dir_ / RandomAlphaNumericString(8)), file_name(RandomAlphaNumericString(8));
+  fs::path file(source / file_name), import_path(RandomAlphaNumericString(8));
+  fs::create_directories(source);
+  {
+    fs::ofstream output(file, std::ios_base::out | std::ios_base::binary);
+    output << RandomString(kDataSize);
+  }
+  fs::resize_file(file, kFileSize);
+  {
+    fs::fstream output(file, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    output.seekp(static_cast<std::streamoff>(kFileSize / 2));
+    output << RandomString(kDataSize);
+  }
+
+  EXPECT_NO_THROW(MountDrive());
+  int64_t used_before(user_storage_->used_space());
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  EXPECT_NO_THROW(user_storage_->ImportDirectory(source, import_path, nullptr));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  int64_t stored(user_storage_->used_space() - used_before);
+  std::cout << "Sparse import, " << stored << " bytes stored: ";
+  PrintResult(start_time, stop_time, static_cast<size_t>(kFileSize), kCopy);
+  encrypt::DataMapPtr data_map(ParseDataMap(user_storage_->GetDataMap(import_path / file_name)));
+  std::set<std::string> distinct_chunks;
+  for (auto& chunk : data_map->chunks)
+    distinct_chunks.insert(chunk.hash);
+  EXPECT_LT(distinct_chunks.size() * 10, data_map->chunks.size());
+  EXPECT_LT(static_cast<uint64_t>(stored), kFileSize / 64);
+
+  fs::path export_path(*test_dir_ / RandomAlphaNumericString(8));
+  start_time = bptime::microsec_clock::universal_time();
+  EXPECT_NO_THROW(user_storage_->ExportDirectory(import_path, export_path, nullptr));
+  stop_time = bptime::microsec_clock::universal_time();
+  std::cout << "Sparse export: ";
+  PrintResult(start_time, stop_time, static_cast<size_t>(kFileSize), kRead);
+  EXPECT_EQ(kFileSize, fs::file_size(export_path / file_name));
+  EXPECT_TRUE(CompareFileContents(export_path / file_name, file));
+  EXPECT_NO_THROW(UnMountDrive());
+}
+
+TEST_F(UserStorageTest, FUNC_SyncLatencyByDurabilityMode) {
+  const uint32_t kWriteSize(64 * 1024), kWriteCount(20);
+  const std::pair<DurabilityMode, std::string> kModes[] = {
+      std::make_pair(DurabilityMode::kWriteThrough, "Write-through"),
+      std::make_pair(DurabilityMode::kWriteBack, "Write-back"),
+      std::make_pair(DurabilityMode::kSyncOnClose, "Sync-on-close") };
+  for (auto& mode : kModes) {
+    MountProfile profile;
+    profile.durability_mode = mode.first;
+    user_storage_->MountDrive(*client_nfs_, session_, profile);
+    ASSERT_TRUE(user_storage_->mount_status());
+    fs::path file_name(RandomAlphaNumericString(8));
+    EXPECT_NO_THROW(user_storage_->InsertDataMap(file_name, std::string()));
+    std::string content;
+    bptime::time_duration write_time, sync_time;
+    for (uint32_t i(0); i != kWriteCount; ++i) {
+      std::string write(RandomString(kWriteSize));
+      content += write;
+      bptime::ptime start_time(bptime::microsec_clock::universal_time());
+      EXPECT_NO_THROW(user_storage_->AppendToFile(file_name, write));
+      bptime::ptime synced_time(bptime::microsec_clock::universal_time());
+      write_time += synced_time - start_time;
+      EXPECT_NO_THROW(user_storage_->Sync());
+      sync_time += bptime::microsec_clock::universal_time() - synced_time;
+    }
+    std::cout << mode.second << ": mean write " << write_time.total_microseconds() / kWriteCount
+              << " us, mean sync " << sync_time.total_microseconds() / kWriteCount << " us"
+              << std::endl;
+    // Whatever the mode, the content is stored once the unmount flush completes.
+    EXPECT_NO_THROW(UnMountDrive());
+    user_storage_->WaitForPendingFlush(session_);
+    EXPECT_NO_THROW(MountDrive());
+    std::string stored;
+    EXPECT_TRUE(ReadFile(owner_path() / file_name, &stored));
+    EXPECT_EQ(content, stored);
+    EXPECT_NO_THROW(UnMountDrive());
+    user_storage_->WaitForPendingFlush(session_);
+  }
+}
+
+TEST_F(UserStorageTest, FUNC_PinnedDirectoryHeldLocally) {
+  fs::path source(CreateTestDirectoriesAndFiles(*test_dir_));
+  fs::path drive_path(source.filename());
+  EXPECT_NO_THROW(MountDrive());
+  EXPECT_NO_THROW(user_storage_->ImportDirectory(source, drive_path, nullptr));
+  EXPECT_THROW(user_storage_->PinPath(RandomAlphaNumericString(8)), std::exception);
+
+  bptime::ptime start_time(bptime::microsec_clock::universal_time());
+  EXPECT_NO_THROW(user_storage_->PinPath(drive_path));
+  bptime::ptime stop_time(bptime::microsec_clock::universal_time());
+  std::cout << "Pinned " << user_storage_->pinned_space() << " bytes in "
+            << (stop_time - start_time).total_milliseconds() << " ms" << std::endl;
+  ASSERT_EQ(1U, user_storage_->PinnedPaths().size());
+  EXPECT_EQ(drive_path, user_storage_->PinnedPaths().front());
+
+  // Pins survive a remount.
+  EXPECT_NO_THROW(UnMountDrive());
+  EXPECT_EQ(0U, user_storage_->pinned_space());
+  EXPECT_NO_THROW(MountDrive());
+  ASSERT_EQ(1U, user_storage_->PinnedPaths().size());
+  EXPECT_NO_THROW(user_storage_->UnpinPath(drive_path));
+  EXPECT_TRUE(user_storage_->PinnedPaths().empty());
+  EXPECT_EQ(0U, user_storage_->pinned_space());
+  EXPECT_NO_THROW(UnMountDrive());
+}
 
 }  // namespace test
 }  // namespace lifestuff